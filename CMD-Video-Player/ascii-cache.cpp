@@ -0,0 +1,433 @@
+//
+//  ascii-cache.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "ascii-cache.hpp"
+#include "basic-functions.hpp"
+#include "video-player.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A cached frame later than this is skipped instead of drawn
+#define ASCII_CACHE_LATE_FRAME 0.1
+// Unchanged gaps shorter than this are cheaper to repeat than to start a new delta run
+#define DELTA_MIN_GAP 3
+
+static void put_varint(std::vector<uint8_t> &out, size_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static bool get_varint(const uint8_t *&p, const uint8_t *end, size_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        value |= static_cast<size_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static void encode_rle(const char *cells, size_t count, std::vector<uint8_t> &out) {
+    out.clear();
+    for (size_t i = 0; i < count;) {
+        size_t run = 1;
+        while (i + run < count && cells[i + run] == cells[i])
+            run++;
+        put_varint(out, run);
+        out.push_back(static_cast<uint8_t>(cells[i]));
+        i += run;
+    }
+}
+
+static void encode_delta(const char *cells, const char *previous, size_t count, std::vector<uint8_t> &out) {
+    out.clear();
+    size_t i = 0;
+    while (i < count) {
+        size_t unchanged = 0;
+        while (i + unchanged < count && cells[i + unchanged] == previous[i + unchanged])
+            unchanged++;
+        if (i + unchanged == count)
+            break; // 剩下的都没变，不用写
+
+        size_t start = i + unchanged, end = start;
+        while (end < count) {
+            if (cells[end] != previous[end]) {
+                end++;
+                continue;
+            }
+            size_t gap = 0;
+            while (end + gap < count && gap < DELTA_MIN_GAP && cells[end + gap] == previous[end + gap])
+                gap++;
+            if (gap == DELTA_MIN_GAP || end + gap == count)
+                break;
+            end += gap;
+        }
+        put_varint(out, unchanged);
+        put_varint(out, end - start);
+        out.insert(out.end(), cells + start, cells + end);
+        i = end;
+    }
+}
+
+AsciiCacheWriter::~AsciiCacheWriter() {
+    if (file)
+        fclose(file);
+}
+
+bool AsciiCacheWriter::open(const std::string &path, int width, int height, bool compress) {
+    file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    header = {};
+    memcpy(header.magic, ASCII_CACHE_MAGIC, sizeof(header.magic));
+    header.version = ASCII_CACHE_VERSION;
+    header.width = width;
+    header.height = height;
+    header.compressed = compress;
+    index.clear();
+    previous.clear();
+    // The real header is written by finish() once the index position is known
+    offset = sizeof(header);
+    return fwrite(&header, sizeof(header), 1, file) == 1;
+}
+
+bool AsciiCacheWriter::add_frame(const GlyphGrid &grid, double pts) {
+    size_t count = static_cast<size_t>(header.width) * header.height;
+    if (!file || grid.cells.size() < count)
+        return false;
+
+    const char *cells = grid.cells.data();
+    AsciiCacheIndexEntry entry = {pts, offset, static_cast<uint32_t>(count), ASCII_FRAME_RAW};
+    const uint8_t *payload = reinterpret_cast<const uint8_t *>(cells);
+    if (header.compressed) {
+        encode_rle(cells, count, encoded);
+        if (encoded.size() < count) {
+            entry.type = ASCII_FRAME_RLE;
+        }
+        if (!previous.empty() && index.size() % ASCII_CACHE_KEYFRAME_INTERVAL != 0) {
+            encode_delta(cells, previous.data(), count, candidate);
+            if (candidate.size() < std::min(encoded.size(), count)) {
+                encoded.swap(candidate);
+                entry.type = ASCII_FRAME_DELTA;
+            }
+        }
+        if (entry.type != ASCII_FRAME_RAW) {
+            payload = encoded.data();
+            entry.size = static_cast<uint32_t>(encoded.size());
+        }
+        previous.assign(cells, cells + count);
+    }
+
+    if (entry.size && fwrite(payload, 1, entry.size, file) != entry.size)
+        return false;
+    offset += entry.size;
+    index.push_back(entry);
+    return true;
+}
+
+bool AsciiCacheWriter::finish(double duration) {
+    if (!file)
+        return false;
+    header.frame_count = static_cast<uint32_t>(index.size());
+    header.duration = duration;
+    header.index_offset = offset;
+    bool ok = index.empty() || fwrite(index.data(), sizeof(AsciiCacheIndexEntry), index.size(), file) == index.size();
+    offset += index.size() * sizeof(AsciiCacheIndexEntry);
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+    file = nullptr;
+    return ok;
+}
+
+AsciiCacheReader::~AsciiCacheReader() {
+    close();
+}
+
+bool AsciiCacheReader::open(const std::string &path) {
+    close();
+#ifdef _WIN32
+    std::ifstream input(path, std::ios::binary);
+    if (!input)
+        return false;
+    file_copy.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    data = file_copy.data();
+    size = file_copy.size();
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < static_cast<off_t>(sizeof(AsciiCacheHeader))) {
+        ::close(fd);
+        return false;
+    }
+    void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // 映射建立后就不需要文件描述符了
+    if (mapped == MAP_FAILED)
+        return false;
+    madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+    data = static_cast<const uint8_t *>(mapped);
+    size = st.st_size;
+#endif
+
+    header = reinterpret_cast<const AsciiCacheHeader *>(data);
+    if (size < sizeof(AsciiCacheHeader) || memcmp(header->magic, ASCII_CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != ASCII_CACHE_VERSION || header->width == 0 || header->height == 0 ||
+        header->index_offset > size ||
+        (size - header->index_offset) / sizeof(AsciiCacheIndexEntry) < header->frame_count) {
+        close();
+        return false;
+    }
+    index = reinterpret_cast<const AsciiCacheIndexEntry *>(data + header->index_offset);
+    return true;
+}
+
+void AsciiCacheReader::close() {
+#ifdef _WIN32
+    file_copy.clear();
+#else
+    if (data)
+        munmap(const_cast<uint8_t *>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+    header = nullptr;
+    index = nullptr;
+}
+
+bool AsciiCacheReader::decode_frame(uint32_t frame, GlyphGrid &grid) const {
+    size_t count = static_cast<size_t>(header->width) * header->height;
+    if (frame >= header->frame_count || grid.cells.size() < count)
+        return false;
+    const AsciiCacheIndexEntry &e = index[frame];
+    if (e.offset > header->index_offset || e.size > header->index_offset - e.offset)
+        return false;
+
+    const uint8_t *p = data + e.offset;
+    const uint8_t *end = p + e.size;
+    char *cells = grid.cells.data();
+    size_t pos = 0, run, changed;
+    switch (e.type) {
+    case ASCII_FRAME_RAW:
+        if (e.size != count)
+            return false;
+        memcpy(cells, p, count);
+        return true;
+    case ASCII_FRAME_RLE:
+        while (pos < count) {
+            if (!get_varint(p, end, run) || p >= end || run > count - pos)
+                return false;
+            memset(cells + pos, *p++, run);
+            pos += run;
+        }
+        return true;
+    case ASCII_FRAME_DELTA:
+        while (p < end) {
+            if (!get_varint(p, end, run) || !get_varint(p, end, changed) || run > count - pos ||
+                changed > count - pos - run || changed > static_cast<size_t>(end - p))
+                return false;
+            pos += run;
+            memcpy(cells + pos, p, changed);
+            p += changed;
+            pos += changed;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool is_ascii_cache_file(const std::string &path) {
+    // Opening a named pipe or stdin would wait for a writer and eat the start of the stream
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(path, ec))
+        return false;
+    char magic[8];
+    std::ifstream input(path, std::ios::binary);
+    return input.read(magic, sizeof(magic)) && memcmp(magic, ASCII_CACHE_MAGIC, sizeof(magic)) == 0;
+}
+
+void export_ascii_cache(const std::map<std::string, std::string> &params) {
+    if (!params_include(params, "-v") || !params_include(params, "-o")) {
+        print_error("Nothing to export", "Add -v and -o params, or type \"help\" to get usage");
+        return;
+    }
+    std::string video_path = params.at("-v");
+    std::string cache_path = params.at("-o");
+    AsciiFunc generate_ascii_func = select_ascii_func(params);
+    // The cache only stores glyph bytes, so ed and br are limited to their ASCII shapes here
+    CellSampling sampling = select_cell_sampling(params);
+    resize_band_pool(select_band_threads(params) - 1);
+    const char *frame_chars = select_frame_chars(params);
+
+    // The frames are converted for this terminal size once and for all
+    int term_width, term_height;
+    get_terminal_size(term_width, term_height);
+    if (params_include(params, "-size") && !parse_size_param(params.at("-size"), term_width, term_height)) {
+        print_error("Invalid -size value, expected WIDTHxHEIGHT", params.at("-size"));
+        return;
+    }
+
+    // Opened like a playback, so pipes, -mm and the probe cache work here as well
+    MediaInput input;
+    std::string error;
+    bool full_decode = params_include(params, "-fd");
+    if (!open_media_input(video_path, full_decode ? 0 : term_width, full_decode ? 0 : term_height, input, error,
+                          select_input_options(params))) {
+        print_error(error, video_path);
+        return;
+    }
+    AVFormatContext *format_ctx = input.format_ctx;
+    AVCodecContext *video_codec_ctx = input.video_codec_ctx;
+    int video_stream_index = input.video_stream_index;
+    AVStream *video_stream = format_ctx->streams[video_stream_index];
+    double frame_duration = 1.0 / std::max(av_q2d(video_stream->avg_frame_rate), 1.0);
+
+    AsciiCacheWriter writer;
+    if (!writer.open(cache_path, term_width, term_height - 2, !params_include(params, "-raw"))) {
+        close_media_input(input);
+        print_error("Error: Could not create cache file", cache_path);
+        return;
+    }
+
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    LumaScaler luma_scaler;
+    cv::Mat scaled_frame;
+    GlyphGrid grid;
+    double pts = -frame_duration;
+    bool draining = false, failed = false;
+    while (!failed) {
+        if (!draining) {
+            if (av_read_frame(format_ctx, packet) < 0) {
+                draining = true;
+                avcodec_send_packet(video_codec_ctx, NULL);
+            } else if (packet->stream_index != video_stream_index) {
+                av_packet_unref(packet);
+                continue;
+            } else {
+                avcodec_send_packet(video_codec_ctx, packet);
+                av_packet_unref(packet);
+            }
+        }
+
+        bool got_frame = false;
+        while (!failed && avcodec_receive_frame(video_codec_ctx, frame) >= 0) {
+            got_frame = true;
+            FrameLayout layout = compute_frame_layout(frame->width, frame->height, term_width, term_height - 2);
+            grid.reset(term_width, term_height - 2);
+            if (luma_scaler.scale(frame, layout.frame_width * sampling.sub_x, layout.frame_height * sampling.sub_y, scaled_frame))
+                generate_ascii_func(scaled_frame, grid, layout.left, layout.top, frame_chars);
+
+            // 没有时间戳的帧接在上一帧后面
+            if (frame->best_effort_timestamp != AV_NOPTS_VALUE)
+                pts = frame->best_effort_timestamp * av_q2d(video_stream->time_base);
+            else
+                pts += frame_duration;
+            failed = !writer.add_frame(grid, pts);
+        }
+        if (draining && !got_frame)
+            break;
+    }
+
+    double duration = format_ctx->duration != AV_NOPTS_VALUE ? static_cast<double>(format_ctx->duration) / AV_TIME_BASE : pts;
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    close_media_input(input);
+
+    if (failed || !writer.finish(duration)) {
+        print_error("Error: Could not write cache file", cache_path);
+        return;
+    }
+    std::cout << "Exported " << video_path << " for a " << term_width << "x" << term_height << " terminal to "
+              << cache_path << " (" << writer.bytes_written() / 1024 << " KB)" << std::endl;
+}
+
+bool stream_ascii_cache(const std::string &cache_path, bool &quit) {
+    AsciiCacheReader reader;
+    if (!reader.open(cache_path)) {
+        print_error("Error: Could not read ASCII cache file", cache_path);
+        return false;
+    }
+    const AsciiCacheHeader &info = reader.info();
+
+    // One extra row below the cached frame for the progress bar
+    GlyphGrid grid;
+    grid.reset(info.width, info.height + 1);
+    // grid has to stay for the next delta, the writer gets a copy. Once the spare buffers have
+    // the same size the copies reuse their memory.
+    GlyphGrid outgoing;
+    TerminalWriter writer;
+    writer.start();
+    bool redraw = false, corrupted = false;
+    TerminalInput terminal_input;
+    terminal_input.start();
+    PlayerCommand command;
+    int termWidth = 0, termHeight = 0, prevTermWidth = -1, prevTermHeight = -1;
+    quit = false;
+
+    auto start = std::chrono::steady_clock::now();
+    double first_pts = info.frame_count ? reader.entry(0).pts : 0;
+    for (uint32_t i = 0; i < info.frame_count; i++) {
+        while (terminal_input.poll(command)) {
+            quit = quit || command == COMMAND_QUIT;
+        }
+        if (quit || is_escape_key_pressed()) {
+            quit = true;
+            break;
+        }
+        // Late frames still have to be applied, the next delta builds on them
+        if (!reader.decode_frame(i, grid)) {
+            corrupted = true;
+            break;
+        }
+        double pts = reader.entry(i).pts;
+        double delay = (pts - first_pts) - std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (delay < -ASCII_CACHE_LATE_FRAME && i + 1 < info.frame_count)
+            continue;
+        if (delay > 0)
+            std::this_thread::sleep_for(std::chrono::duration<double>(delay));
+
+        get_terminal_size(termWidth, termHeight);
+        if (termWidth != prevTermWidth || termHeight != prevTermHeight) {
+            prevTermWidth = termWidth;
+            prevTermHeight = termHeight;
+            redraw = true;
+        }
+        draw_status_line(grid, "", static_cast<int64_t>(std::max(pts, 0.0)), static_cast<int64_t>(info.duration));
+        outgoing = grid;
+        writer.submit(outgoing, redraw);
+        redraw = false;
+    }
+    writer.stop();
+    terminal_input.stop();
+    if (corrupted)
+        print_error("Error: Corrupted frame in ASCII cache file", cache_path);
+    return true;
+}
+
+void play_ascii_cache(const std::map<std::string, std::string> &params) {
+    bool quit;
+    if (!stream_ascii_cache(params.at("-v"), quit))
+        return;
+    if (!quit) {
+        std::cout << "Playback completed! Press any key to continue...";
+        getchar();
+        clear_screen();
+    } else {
+        clear_screen();
+        std::cout << "Playback interrupted!\n";
+    }
+}
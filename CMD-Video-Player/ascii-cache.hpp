@@ -0,0 +1,106 @@
+//
+//  ascii-cache.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef ascii_cache_hpp
+#define ascii_cache_hpp
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "terminal-renderer.hpp"
+
+// On-disk layout of an exported clip, all fields little endian:
+//   AsciiCacheHeader | frame data ... | AsciiCacheIndexEntry[frame_count]
+// Every frame is the glyph grid of the video area (the status row is drawn at playback),
+// stored raw, run-length encoded or as a delta against the previous frame.
+#define ASCII_CACHE_MAGIC "CVPASCII"
+#define ASCII_CACHE_VERSION 1
+#define ASCII_CACHE_KEYFRAME_INTERVAL 250 // 每隔多少帧强制存一个不依赖前一帧的帧
+
+enum AsciiCacheFrameType : uint32_t {
+    ASCII_FRAME_RAW = 0,   // width * height glyphs
+    ASCII_FRAME_RLE = 1,   // (varint count, glyph) pairs
+    ASCII_FRAME_DELTA = 2, // (varint unchanged, varint changed, changed glyphs) against the previous frame
+};
+
+struct AsciiCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t frame_count;
+    double duration; // seconds
+    uint64_t index_offset;
+    uint8_t compressed;
+    uint8_t reserved[23];
+};
+static_assert(sizeof(AsciiCacheHeader) == 64, "cache header must stay 64 bytes");
+
+struct AsciiCacheIndexEntry {
+    double pts; // seconds
+    uint64_t offset;
+    uint32_t size;
+    uint32_t type;
+};
+static_assert(sizeof(AsciiCacheIndexEntry) == 24, "cache index entry must stay 24 bytes");
+
+// Appends grids to a cache file, the index and header are written by finish()
+class AsciiCacheWriter {
+public:
+    ~AsciiCacheWriter();
+
+    bool open(const std::string &path, int width, int height, bool compress);
+    bool add_frame(const GlyphGrid &grid, double pts);
+    bool finish(double duration);
+
+    uint64_t bytes_written() const { return offset; }
+
+private:
+    FILE *file = nullptr;
+    AsciiCacheHeader header = {};
+    std::vector<AsciiCacheIndexEntry> index;
+    std::vector<char> previous;
+    std::vector<uint8_t> encoded, candidate;
+    uint64_t offset = 0;
+};
+
+// Read-only view of a cache file mapped into memory
+class AsciiCacheReader {
+public:
+    ~AsciiCacheReader();
+
+    bool open(const std::string &path);
+    void close();
+
+    const AsciiCacheHeader &info() const { return *header; }
+    const AsciiCacheIndexEntry &entry(uint32_t frame) const { return index[frame]; }
+    // Applies frame onto grid, which must hold the previous frame when it is a delta
+    bool decode_frame(uint32_t frame, GlyphGrid &grid) const;
+
+private:
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    const AsciiCacheHeader *header = nullptr;
+    const AsciiCacheIndexEntry *index = nullptr;
+#ifdef _WIN32
+    std::vector<uint8_t> file_copy; // no mmap here, the file is read in one go
+#endif
+};
+
+bool is_ascii_cache_file(const std::string &path);
+
+// export: runs the conversion once for a fixed terminal size and writes a cache file
+void export_ascii_cache(const std::map<std::string, std::string> &params);
+// Streams a cache file to the terminal without decoding or converting anything.
+// quit tells whether the user stopped it, false means the file could not be read.
+bool stream_ascii_cache(const std::string &cache_path, bool &quit);
+void play_ascii_cache(const std::map<std::string, std::string> &params);
+
+#endif /* ascii_cache_hpp */
@@ -0,0 +1,160 @@
+//
+//  ascii-kernel.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "ascii-kernel.hpp"
+
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define GLYPH_KERNEL_X86 1
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define GLYPH_KERNEL_NEON 1
+#include <arm_neon.h>
+#endif
+
+void build_glyph_lut(GlyphLUT &lut, const char *ascii_chars, int min_value, int max_value) {
+    unsigned long ascii_length = strlen(ascii_chars);
+    if (ascii_length == 0) {
+        ascii_chars = " ";
+        ascii_length = 1;
+    }
+
+    for (int pixel = 0; pixel < 256; ++pixel) {
+        int scaled_pixel = pixel;
+        if (min_value != 0 || max_value != 255) {
+            // 与逐像素版本相同的缩放方式：先拉伸到 0-255 再截断
+            if (max_value <= min_value || pixel <= min_value)
+                scaled_pixel = 0;
+            else if (pixel >= max_value)
+                scaled_pixel = 255;
+            else
+                scaled_pixel = static_cast<uint8_t>(255.0 * (pixel - min_value) / (max_value - min_value));
+        }
+        lut.glyphs[pixel] = ascii_chars[(scaled_pixel * ascii_length) / 256];
+    }
+
+    // Every change between neighbouring entries becomes one step
+    lut.step_count = 0;
+    for (int pixel = 1; pixel < 256; ++pixel) {
+        if (lut.glyphs[pixel] == lut.glyphs[pixel - 1])
+            continue;
+        if (lut.step_count == MAX_GLYPH_STEPS) {
+            lut.step_count = -1;
+            break;
+        }
+        lut.step_thresholds[lut.step_count] = static_cast<uint8_t>(pixel);
+        lut.step_deltas[lut.step_count] = static_cast<uint8_t>(lut.glyphs[pixel] - lut.glyphs[pixel - 1]);
+        lut.step_count++;
+    }
+}
+
+const GlyphLUT &get_glyph_lut(const char *ascii_chars, int min_value, int max_value) {
+    thread_local GlyphLUT lut;
+    thread_local std::string lut_chars;
+    thread_local int lut_min = -1, lut_max = -1;
+
+    if (lut_min != min_value || lut_max != max_value || lut_chars != ascii_chars) {
+        build_glyph_lut(lut, ascii_chars, min_value, max_value);
+        lut_chars = ascii_chars;
+        lut_min = min_value;
+        lut_max = max_value;
+    }
+    return lut;
+}
+
+static void map_row_scalar(const GlyphLUT &lut, const uint8_t *src, char *dst, int count) {
+    for (int i = 0; i < count; ++i) {
+        dst[i] = lut.glyphs[src[i]];
+    }
+}
+
+// glyph = glyphs[0] + sum of the deltas of every step whose threshold <= pixel
+#ifdef GLYPH_KERNEL_X86
+static void map_row_sse2(const GlyphLUT &lut, const uint8_t *src, char *dst, int count) {
+    const __m128i base = _mm_set1_epi8(lut.glyphs[0]);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i glyphs = base;
+        for (int s = 0; s < lut.step_count; ++s) {
+            __m128i threshold = _mm_set1_epi8(static_cast<char>(lut.step_thresholds[s]));
+            __m128i reached = _mm_cmpeq_epi8(_mm_max_epu8(pixels, threshold), pixels);
+            glyphs = _mm_add_epi8(glyphs, _mm_and_si128(reached, _mm_set1_epi8(static_cast<char>(lut.step_deltas[s]))));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), glyphs);
+    }
+    map_row_scalar(lut, src + i, dst + i, count - i);
+}
+
+__attribute__((target("avx2"))) static void map_row_avx2(const GlyphLUT &lut, const uint8_t *src, char *dst, int count) {
+    const __m256i base = _mm256_set1_epi8(lut.glyphs[0]);
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+        __m256i glyphs = base;
+        for (int s = 0; s < lut.step_count; ++s) {
+            __m256i threshold = _mm256_set1_epi8(static_cast<char>(lut.step_thresholds[s]));
+            __m256i reached = _mm256_cmpeq_epi8(_mm256_max_epu8(pixels, threshold), pixels);
+            glyphs = _mm256_add_epi8(glyphs, _mm256_and_si256(reached, _mm256_set1_epi8(static_cast<char>(lut.step_deltas[s]))));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), glyphs);
+    }
+    map_row_sse2(lut, src + i, dst + i, count - i);
+}
+#endif
+
+#ifdef GLYPH_KERNEL_NEON
+static void map_row_neon(const GlyphLUT &lut, const uint8_t *src, char *dst, int count) {
+    const uint8x16_t base = vdupq_n_u8(static_cast<uint8_t>(lut.glyphs[0]));
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16_t pixels = vld1q_u8(src + i);
+        uint8x16_t glyphs = base;
+        for (int s = 0; s < lut.step_count; ++s) {
+            uint8x16_t reached = vcgeq_u8(pixels, vdupq_n_u8(lut.step_thresholds[s]));
+            glyphs = vaddq_u8(glyphs, vandq_u8(reached, vdupq_n_u8(lut.step_deltas[s])));
+        }
+        vst1q_u8(reinterpret_cast<uint8_t *>(dst + i), glyphs);
+    }
+    map_row_scalar(lut, src + i, dst + i, count - i);
+}
+#endif
+
+typedef void (*RowKernel)(const GlyphLUT &, const uint8_t *, char *, int);
+
+struct SelectedKernel {
+    RowKernel kernel;
+    const char *name;
+};
+
+static SelectedKernel select_kernel() {
+#ifdef GLYPH_KERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return {map_row_avx2, "avx2"};
+    return {map_row_sse2, "sse2"};
+#elif defined(GLYPH_KERNEL_NEON)
+    return {map_row_neon, "neon"};
+#else
+    return {map_row_scalar, "scalar"};
+#endif
+}
+
+static const SelectedKernel selected_kernel = select_kernel();
+
+void map_row_to_glyphs(const GlyphLUT &lut, const uint8_t *src, char *dst, int count) {
+    if (lut.step_count < 0) {
+        map_row_scalar(lut, src, dst, count);
+        return;
+    }
+    selected_kernel.kernel(lut, src, dst, count);
+}
+
+const char *glyph_kernel_name() {
+    return selected_kernel.name;
+}
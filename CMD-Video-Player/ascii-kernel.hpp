@@ -0,0 +1,38 @@
+//
+//  ascii-kernel.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef ascii_kernel_hpp
+#define ascii_kernel_hpp
+
+#include <cstdint>
+#include <string>
+
+#define MAX_GLYPH_STEPS 16
+
+// Luminance -> glyph lookup table for one charset and contrast range.
+// The table is a step function, so besides the 256 plain entries it is also kept
+// as (threshold, delta) steps that the SIMD kernels evaluate 16/32 pixels at a time.
+struct GlyphLUT {
+    char glyphs[256];
+    int step_count; // -1 when there are too many steps to vectorize
+    uint8_t step_thresholds[MAX_GLYPH_STEPS];
+    uint8_t step_deltas[MAX_GLYPH_STEPS];
+};
+
+// min_value/max_value stretch that range to the full charset, like the dynamic contrast mode
+void build_glyph_lut(GlyphLUT &lut, const char *ascii_chars, int min_value = 0, int max_value = 255);
+
+// Per-thread cached table, rebuilt only when the charset or range changes
+const GlyphLUT &get_glyph_lut(const char *ascii_chars, int min_value = 0, int max_value = 255);
+
+// Writes count glyph bytes for count luminance bytes, using the best kernel for this CPU
+void map_row_to_glyphs(const GlyphLUT &lut, const uint8_t *src, char *dst, int count);
+
+// "avx2", "sse2", "neon" or "scalar"
+const char *glyph_kernel_name();
+
+#endif /* ascii_kernel_hpp */
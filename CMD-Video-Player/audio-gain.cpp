@@ -0,0 +1,60 @@
+//
+//  audio-gain.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "audio-gain.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define AUDIO_GAIN_X86 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define AUDIO_GAIN_NEON 1
+#include <arm_neon.h>
+#endif
+
+// log2(AUDIO_GAIN_UNITY)
+#define AUDIO_GAIN_SHIFT 7
+
+void apply_gain_s16(int16_t *dst, const int16_t *src, size_t count, int volume) {
+    volume = std::clamp(volume, 0, AUDIO_GAIN_UNITY);
+    if (volume == AUDIO_GAIN_UNITY) {
+        if (dst != src)
+            memmove(dst, src, count * sizeof(int16_t));
+        return;
+    }
+    if (volume == 0) {
+        memset(dst, 0, count * sizeof(int16_t));
+        return;
+    }
+
+    size_t i = 0;
+#ifdef AUDIO_GAIN_X86
+    // 16x16 位乘法的高低两半拼成 32 位乘积，移位后再压回 16 位
+    const __m128i gain = _mm_set1_epi16(static_cast<short>(volume));
+    for (; i + 8 <= count; i += 8) {
+        __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        __m128i lo = _mm_mullo_epi16(samples, gain);
+        __m128i hi = _mm_mulhi_epi16(samples, gain);
+        __m128i first = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), AUDIO_GAIN_SHIFT);
+        __m128i second = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), AUDIO_GAIN_SHIFT);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(first, second));
+    }
+#elif defined(AUDIO_GAIN_NEON)
+    const int16x4_t gain = vdup_n_s16(static_cast<int16_t>(volume));
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t samples = vld1q_s16(src + i);
+        int32x4_t first = vmull_s16(vget_low_s16(samples), gain);
+        int32x4_t second = vmull_s16(vget_high_s16(samples), gain);
+        vst1q_s16(dst + i, vcombine_s16(vshrn_n_s32(first, AUDIO_GAIN_SHIFT), vshrn_n_s32(second, AUDIO_GAIN_SHIFT)));
+    }
+#endif
+    for (; i < count; ++i) {
+        dst[i] = static_cast<int16_t>((src[i] * volume) >> AUDIO_GAIN_SHIFT);
+    }
+}
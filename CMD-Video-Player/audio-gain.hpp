@@ -0,0 +1,22 @@
+//
+//  audio-gain.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef audio_gain_hpp
+#define audio_gain_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+// Full volume, the same scale as SDL_MIX_MAXVOLUME
+#define AUDIO_GAIN_UNITY 128
+
+// dst[i] = src[i] * volume / AUDIO_GAIN_UNITY for count native-endian S16 samples, volume in 0-128.
+// dst may be src. Replaces SDL_MixAudioFormat in the callback: nothing is mixed, so no silence
+// has to be written first and unity gain is a plain copy.
+void apply_gain_s16(int16_t *dst, const int16_t *src, size_t count, int volume);
+
+#endif /* audio_gain_hpp */
@@ -0,0 +1,71 @@
+//
+//  audio-ring-buffer.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "audio-ring-buffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+AudioRingBuffer::AudioRingBuffer(size_t capacity) {
+    // 保持 64 字节对齐，回绕点不会切开一个采样
+    capacity = std::max<size_t>((capacity + 63) & ~size_t(63), 64);
+    buffer.resize(capacity);
+}
+
+bool AudioRingBuffer::write(const uint8_t *data, size_t size) {
+    if (size > free_space())
+        return false;
+
+    uint64_t tail = write_pos.load(std::memory_order_relaxed);
+    size_t offset = tail % buffer.size();
+    size_t first = std::min(size, buffer.size() - offset);
+    memcpy(buffer.data() + offset, data, first);
+    memcpy(buffer.data(), data + first, size - first);
+    write_pos.store(tail + size, std::memory_order_release);
+    return true;
+}
+
+size_t AudioRingBuffer::free_space() const {
+    return buffer.size() - size();
+}
+
+size_t AudioRingBuffer::reserve(uint8_t **data) {
+    uint64_t tail = write_pos.load(std::memory_order_relaxed);
+    size_t offset = tail % buffer.size();
+    *data = buffer.data() + offset;
+    return std::min(free_space(), buffer.size() - offset);
+}
+
+void AudioRingBuffer::commit(size_t size) {
+    write_pos.store(write_pos.load(std::memory_order_relaxed) + size, std::memory_order_release);
+}
+
+void AudioRingBuffer::discard_pending() {
+    discard_until.store(write_pos.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+size_t AudioRingBuffer::peek(const uint8_t **data) {
+    uint64_t head = read_pos.load(std::memory_order_relaxed);
+    uint64_t discard = discard_until.load(std::memory_order_acquire);
+    if (discard > head) {
+        head = discard;
+        read_pos.store(head, std::memory_order_release);
+    }
+
+    uint64_t available = write_pos.load(std::memory_order_acquire) - head;
+    size_t offset = head % buffer.size();
+    *data = buffer.data() + offset;
+    return static_cast<size_t>(std::min<uint64_t>(available, buffer.size() - offset));
+}
+
+void AudioRingBuffer::consume(size_t size) {
+    read_pos.store(read_pos.load(std::memory_order_relaxed) + size, std::memory_order_release);
+}
+
+size_t AudioRingBuffer::size() const {
+    return static_cast<size_t>(write_pos.load(std::memory_order_acquire) - read_pos.load(std::memory_order_acquire));
+}
@@ -0,0 +1,58 @@
+//
+//  audio-ring-buffer.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef audio_ring_buffer_hpp
+#define audio_ring_buffer_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define DEFAULT_AUDIO_QUEUE_SIZE 1024 * 1024 // 1MB buffer
+
+// Single-producer/single-consumer byte ring between the audio decoder and the SDL callback.
+// Neither side takes a lock or moves buffered data around.
+class AudioRingBuffer {
+public:
+    explicit AudioRingBuffer(size_t capacity = DEFAULT_AUDIO_QUEUE_SIZE);
+
+    AudioRingBuffer(const AudioRingBuffer &) = delete;
+    AudioRingBuffer &operator=(const AudioRingBuffer &) = delete;
+
+    // Producer: appends all of data or nothing
+    bool write(const uint8_t *data, size_t size);
+    size_t free_space() const;
+    // Producer: the longest free block that does not wrap around, to be filled in place
+    // (e.g. by the resampler) and published with commit()
+    size_t reserve(uint8_t **data);
+    void commit(size_t size);
+    // Producer: everything written so far gets dropped by the consumer, e.g. after a seek
+    void discard_pending();
+
+    // Consumer: the longest readable block that does not wrap around, 0 when empty
+    size_t peek(const uint8_t **data);
+    void consume(size_t size);
+
+    size_t size() const;
+    size_t capacity() const { return buffer.size(); }
+    // Absolute byte positions since the ring was created, used to time the audio
+    uint64_t read_position() const { return read_pos.load(std::memory_order_acquire); }
+    uint64_t write_position() const { return write_pos.load(std::memory_order_acquire); }
+    bool has_been_fed() const { return write_pos.load(std::memory_order_relaxed) > 0; }
+
+    std::atomic<uint64_t> underruns{0};      // callbacks that could not be filled completely
+    std::atomic<uint64_t> overflow_drops{0}; // decoded chunks thrown away because the ring stayed full
+
+private:
+    std::vector<uint8_t> buffer;
+    alignas(64) std::atomic<uint64_t> read_pos{0};
+    alignas(64) std::atomic<uint64_t> write_pos{0};
+    std::atomic<uint64_t> discard_until{0};
+};
+
+#endif /* audio_ring_buffer_hpp */
@@ -0,0 +1,286 @@
+//
+//  avio-input.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "avio-input.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+extern "C" {
+#include <libavformat/avio.h>
+#include <libavutil/error.h>
+#include <libavutil/mem.h>
+}
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// What the demuxer asks for per read, and the most the I/O thread reads in one go
+#define AVIO_BUFFER_SIZE 64 * 1024
+// Copies out of a mapping are cheap, larger blocks mean fewer callbacks
+#define MAPPED_AVIO_BUFFER_SIZE 256 * 1024
+#define PIPE_READ_CHUNK 256 * 1024
+// The I/O thread looks at the stop flag this often while the writer is silent
+#define PIPE_POLL_MS 100
+
+bool is_pipe_input_path(const std::string &path) {
+    if (path == "-")
+        return true;
+#ifdef _WIN32
+    return false;
+#else
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return false;
+    return S_ISFIFO(info.st_mode) || S_ISCHR(info.st_mode);
+#endif
+}
+
+PipeInput::~PipeInput() {
+    stopped = true;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        space_ready.notify_all();
+        data_ready.notify_all();
+    }
+    if (io_thread.joinable())
+        io_thread.join();
+    if (avio_ctx) {
+        av_freep(&avio_ctx->buffer);
+        avio_context_free(&avio_ctx);
+    }
+    if (close_fd) {
+#ifdef _WIN32
+        _close(fd);
+#else
+        close(fd);
+#endif
+    }
+}
+
+bool PipeInput::open(const std::string &path, size_t buffer_size, std::string &error) {
+    if (path == "-") {
+#ifdef _WIN32
+        fd = _fileno(stdin);
+        _setmode(fd, _O_BINARY);
+#else
+        fd = STDIN_FILENO;
+#endif
+    } else {
+#ifdef _WIN32
+        fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+#endif
+        close_fd = fd >= 0;
+    }
+    if (fd < 0) {
+        error = "Error: Could not open input pipe";
+        return false;
+    }
+
+    uint8_t *avio_buffer = static_cast<uint8_t *>(av_malloc(AVIO_BUFFER_SIZE));
+    if (avio_buffer)
+        avio_ctx = avio_alloc_context(avio_buffer, AVIO_BUFFER_SIZE, 0, this, read_packet, NULL, NULL);
+    if (!avio_ctx) {
+        av_free(avio_buffer);
+        error = "Error: Could not allocate the input buffer";
+        return false;
+    }
+    avio_ctx->seekable = 0;
+
+    buffer.resize(std::max<size_t>(buffer_size, PIPE_READ_CHUNK));
+    io_thread = std::thread(&PipeInput::io_thread_func, this);
+    return true;
+}
+
+void PipeInput::interrupt() {
+    stopped = true;
+    std::lock_guard<std::mutex> lock(mutex);
+    data_ready.notify_all();
+    space_ready.notify_all();
+}
+
+size_t PipeInput::buffered() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return filled;
+}
+
+void PipeInput::io_thread_func() {
+    while (!stopped) {
+        // Only this thread writes into the free part of the ring, so the read itself needs no lock
+        uint8_t *target;
+        size_t length;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            space_ready.wait(lock, [&] { return stopped || filled < buffer.size(); });
+            if (stopped)
+                break;
+            size_t write_index = (read_index + filled) % buffer.size();
+            length = std::min({buffer.size() - filled, buffer.size() - write_index, (size_t)PIPE_READ_CHUNK});
+            target = buffer.data() + write_index;
+        }
+
+#ifdef _WIN32
+        // 管道没有 poll，写端关闭时 _read 才会返回
+        long count = _read(fd, target, static_cast<unsigned>(length));
+#else
+        struct pollfd waiting = {fd, POLLIN, 0};
+        int ready = poll(&waiting, 1, PIPE_POLL_MS);
+        if (ready == 0 || (ready < 0 && errno == EINTR))
+            continue;
+        ssize_t count = ready < 0 ? -1 : read(fd, target, length);
+        if (count < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+#endif
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (count <= 0) {
+            end_of_input = true;
+            data_ready.notify_all();
+            break;
+        }
+        filled += count;
+        bytes_read += count;
+        data_ready.notify_all();
+    }
+}
+
+int PipeInput::read_packet(void *opaque, uint8_t *data, int size) {
+    PipeInput *input = static_cast<PipeInput *>(opaque);
+    std::unique_lock<std::mutex> lock(input->mutex);
+    if (input->filled == 0 && !input->end_of_input && !input->stopped) {
+        input->empty_waits++;
+        input->data_ready.wait(lock, [&] { return input->filled > 0 || input->end_of_input || input->stopped; });
+    }
+    if (input->filled == 0)
+        return input->stopped ? AVERROR_EXIT : AVERROR_EOF;
+
+    // At most two copies, the second one after the ring wraps around
+    size_t capacity = input->buffer.size();
+    size_t copied = 0, wanted = std::min(static_cast<size_t>(size), input->filled);
+    while (copied < wanted) {
+        size_t length = std::min(wanted - copied, capacity - input->read_index);
+        memcpy(data + copied, input->buffer.data() + input->read_index, length);
+        input->read_index = (input->read_index + length) % capacity;
+        copied += length;
+    }
+    input->filled -= copied;
+    input->space_ready.notify_one();
+    return static_cast<int>(copied);
+}
+
+MappedFileInput::~MappedFileInput() {
+    if (avio_ctx) {
+        av_freep(&avio_ctx->buffer);
+        avio_context_free(&avio_ctx);
+    }
+#ifndef _WIN32
+    if (data)
+        munmap(const_cast<uint8_t *>(data), size);
+#endif
+}
+
+bool MappedFileInput::open(const std::string &path, std::string &error) {
+#ifdef _WIN32
+    error = "Error: Memory-mapped input is not supported on this system";
+    return false;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "Error: Could not open video file";
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        ::close(fd);
+        error = "Error: Only non-empty regular files can be mapped";
+        return false;
+    }
+    void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // 映射建立后就不需要文件描述符了
+    if (mapped == MAP_FAILED) {
+        error = "Error: Could not map video file";
+        return false;
+    }
+    data = static_cast<const uint8_t *>(mapped);
+    size = st.st_size;
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    advise_readahead();
+
+    uint8_t *avio_buffer = static_cast<uint8_t *>(av_malloc(MAPPED_AVIO_BUFFER_SIZE));
+    if (avio_buffer)
+        avio_ctx = avio_alloc_context(avio_buffer, MAPPED_AVIO_BUFFER_SIZE, 0, this, read_packet, NULL, seek);
+    if (!avio_ctx) {
+        av_free(avio_buffer);
+        error = "Error: Could not allocate the input buffer";
+        return false;
+    }
+    avio_ctx->seekable = AVIO_SEEKABLE_NORMAL;
+    return true;
+#endif
+}
+
+// Keeps MAPPED_READAHEAD_SIZE ahead of the position requested, in steps of half of it
+void MappedFileInput::advise_readahead() {
+#ifndef _WIN32
+    if (position < advised_until && advised_until - position >= MAPPED_READAHEAD_SIZE / 2)
+        return;
+    long page_size = sysconf(_SC_PAGESIZE);
+    size_t begin = position / page_size * page_size;
+    size_t end = std::min(size, position + MAPPED_READAHEAD_SIZE);
+    if (begin < end)
+        madvise(const_cast<uint8_t *>(data) + begin, end - begin, MADV_WILLNEED);
+    advised_until = end;
+#endif
+}
+
+int MappedFileInput::read_packet(void *opaque, uint8_t *buffer, int buffer_size) {
+    MappedFileInput *input = static_cast<MappedFileInput *>(opaque);
+    if (input->position >= input->size)
+        return AVERROR_EOF;
+    size_t length = std::min(static_cast<size_t>(buffer_size), input->size - input->position);
+    memcpy(buffer, input->data + input->position, length);
+    input->position += length;
+    input->advise_readahead();
+    return static_cast<int>(length);
+}
+
+int64_t MappedFileInput::seek(void *opaque, int64_t offset, int whence) {
+    MappedFileInput *input = static_cast<MappedFileInput *>(opaque);
+    int64_t target;
+    switch (whence & ~AVSEEK_FORCE) {
+        case AVSEEK_SIZE:
+            return static_cast<int64_t>(input->size);
+        case SEEK_SET:
+            target = offset;
+            break;
+        case SEEK_CUR:
+            target = static_cast<int64_t>(input->position) + offset;
+            break;
+        case SEEK_END:
+            target = static_cast<int64_t>(input->size) + offset;
+            break;
+        default:
+            return AVERROR(EINVAL);
+    }
+    if (target < 0)
+        return AVERROR(EINVAL);
+    input->position = static_cast<size_t>(target);
+    // 跳转后从新位置重新预读
+    input->advised_until = 0;
+    input->advise_readahead();
+    return target;
+}
@@ -0,0 +1,98 @@
+//
+//  avio-input.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef avio_input_hpp
+#define avio_input_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct AVIOContext;
+
+#define DEFAULT_PIPE_BUFFER_SIZE 8 * 1024 * 1024 // 8MB read-ahead
+#define MAPPED_READAHEAD_SIZE 16 * 1024 * 1024   // 读取位置之前预先让内核载入的映射范围
+
+// True for "-" (stdin), named pipes and character devices, which cannot be opened by path and seeked
+bool is_pipe_input_path(const std::string &path);
+
+// Custom AVIOContext over stdin or a pipe. An I/O thread keeps reading ahead into a large buffer,
+// so a writer that stalls for a moment does not stall the demuxer. Not seekable.
+class PipeInput {
+public:
+    PipeInput() = default;
+    PipeInput(const PipeInput &) = delete;
+    PipeInput &operator=(const PipeInput &) = delete;
+    ~PipeInput();
+
+    // Blocks until a named pipe has a writer, starts the I/O thread
+    bool open(const std::string &path, size_t buffer_size, std::string &error);
+    // Goes into AVFormatContext::pb together with AVFMT_FLAG_CUSTOM_IO
+    AVIOContext *avio() const { return avio_ctx; }
+    // Makes a read that is waiting for data fail, so a playback can stop while the writer is silent
+    void interrupt();
+
+    size_t buffered() const;
+    size_t capacity() const { return buffer.size(); }
+    uint64_t total_read() const { return bytes_read; }
+    // Reads that found the buffer empty and had to wait for the writer
+    uint64_t stalls() const { return empty_waits; }
+
+private:
+    static int read_packet(void *opaque, uint8_t *data, int size);
+    void io_thread_func();
+
+    int fd = -1;
+    bool close_fd = false;
+    AVIOContext *avio_ctx = nullptr;
+    std::thread io_thread;
+
+    std::vector<uint8_t> buffer;
+    size_t read_index = 0; // 环形缓冲区里第一个未读字节
+    size_t filled = 0;
+    bool end_of_input = false;
+    mutable std::mutex mutex;
+    std::condition_variable data_ready, space_ready;
+    std::atomic<bool> stopped{false};
+
+    std::atomic<uint64_t> bytes_read{0};
+    std::atomic<uint64_t> empty_waits{0};
+};
+
+// Custom AVIOContext over a memory-mapped local file: reads are copies out of the mapping
+// instead of read(2) calls, seeks only move the position. The kernel is asked to read
+// MAPPED_READAHEAD_SIZE ahead of the demuxer. POSIX only, open() fails elsewhere.
+// A file that shrinks while it is mapped makes reads past its new end crash (SIGBUS).
+class MappedFileInput {
+public:
+    MappedFileInput() = default;
+    MappedFileInput(const MappedFileInput &) = delete;
+    MappedFileInput &operator=(const MappedFileInput &) = delete;
+    ~MappedFileInput();
+
+    bool open(const std::string &path, std::string &error);
+    // Goes into AVFormatContext::pb together with AVFMT_FLAG_CUSTOM_IO
+    AVIOContext *avio() const { return avio_ctx; }
+
+private:
+    static int read_packet(void *opaque, uint8_t *data, int size);
+    static int64_t seek(void *opaque, int64_t offset, int whence);
+    void advise_readahead();
+
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    size_t position = 0;
+    size_t advised_until = 0; // end of the range handed to MADV_WILLNEED last
+    AVIOContext *avio_ctx = nullptr;
+};
+
+#endif /* avio_input_hpp */
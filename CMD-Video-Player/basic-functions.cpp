@@ -141,18 +141,68 @@ void show_help(bool show_full) {
     if (show_full) {
         std::cout << R"(
 Usage:
-  play -v /path/to/video [-ct st/dy] [-c s/l] [-chars "@%#*+=-:. "]
+  play -v /path/to/video [-ct st/dy/ed/br] [-dt] [-c s/l] [-chars "@%#*+=-:. "] [-cm 256] [-aq 1024] [-ib 8192] [-mm] [-j 4] [-ad] [-hud] [-fd] [-qd] [-vb]
+  play -v /path/to/folder|'clips/*.mp4'|list.m3u [-loop] [other play options]
+  bench -v /path/to/video [-ct st/dy/ed/br] [-dt] [-c s/l] [-chars "..."] [-cm 256] [-mm] [-j 4] [-size 200x60] [-frames N] [-o /dev/null]
+  export -v /path/to/video -o /path/to/clip.cva [-ct st/dy/ed/br] [-dt] [-c s/l] [-chars "..."] [-size 200x60] [-raw]
+  serve -v /path/to/video -l unix:/tmp/cvp.sock|tcp:[host:]port [-sizes 160x48,80x24] [-ct st/dy/ed/br] [-dt] [-c s/l] [-cm 256] [-j 4]
+  watch -l unix:/tmp/cvp.sock|tcp:[host:]port [-size 80x24]
 
 Options:
   -v /path/to/video    Specify the video file to play
-  -ct [st|dy]          Choose the contrast mode for ASCII art generation
+                        A folder, a quoted pattern like 'clips/*.mp4' or an .m3u file plays a playlist
+                        - reads the video from stdin, named pipes work as well (no seeking then)
+  -loop                (playlist) Start over after the last item
+  -ct [st|dy|ed|br]    Choose the contrast mode for ASCII art generation
                         st: Static contrast (default)
                         dy: Dynamic contrast, scales the contrast dynamically based on the video
+                        ed: Edge-aware, picks the glyph or block element whose shape fits each cell
+                        br: Braille, 2x4 dots per cell (needs a font with Braille patterns)
+                        (export stores ed and br with ASCII glyphs only)
+  -dt                  (ed/br) Ordered dithering instead of a threshold per cell
   -c [s|l]             Choose the character set for ASCII art
                         s: Short character set "@#*+-:. " (default)
                         l: Long character set "@%#*+=^~-;:,'.` "
   -chars "sequence"    Set a custom character sequence for ASCII art (perior to -c)
                         Example: "@%#*+=-:. "
+  -cm [mono|256|true|256h|trueh]
+                       Color mode, needs a terminal with ANSI colors
+                        mono: Monochrome glyphs (default)
+                        256: Glyphs colored from the xterm 256-color palette
+                        true: Glyphs in 24-bit color
+                        256h/trueh: Half blocks, two colored pixels per cell instead of glyphs
+  -aq size             Audio queue size in KB (default 1024)
+  -ib size             Read-ahead buffer for stdin and pipes in KB (default 8192)
+  -mm                  Read local files through a memory mapping instead of read calls
+                        (compare both with bench, the read row shows the demuxer time)
+  -j N                 Threads converting each frame in row bands (default: half the cores, up to 8)
+                        1 keeps every frame on one thread, helps on very large terminals
+  -ad                  Adaptive quality: when playback can't keep up, skip every other frame, then
+                        shrink the picture, then use static contrast, then drop colors, and go back
+                        up once there is headroom. The status line shows the current steps
+  -fd                  Full-quality decoding even when the terminal is far smaller than the video
+                        (by default lowres, deblocking and B-frame IDCT are cut back then)
+  -hud                 Start with the stats line shown (press h during playback to toggle it):
+                        fps, drops, ms per stage, bytes per frame, audio buffer and A/V drift
+  -qd                  Show the queue depth of each playback stage in the status line
+  -vb                  Print the audio stream details and audio devices before playback
+  -size WxH            (bench) Virtual terminal size, default 200x60
+  -frames N            (bench) Stop after N frames, default: whole video
+  -o /path/to/file     (bench) Also write the terminal output there, e.g. /dev/null
+                       (export) The ASCII cache file to create, play it with play -v
+  -size WxH            (export) Terminal size to convert for, default: current terminal
+  -raw                 (export) Store every frame uncompressed instead of RLE/delta encoded
+  -l address           (serve/watch) Where the broadcast is offered or found: unix:/path, a bare socket
+                        path, tcp:port (localhost only) or tcp:host:port
+  -sizes WxH,WxH       (serve) Terminal sizes to convert for, each client gets the largest one that
+                        fits its terminal. Default: -size, or the current terminal
+  -size WxH            (watch) Terminal size to ask the server for, default: current terminal
+
+Keys during playback:
+  Left/Right           Seek 5 seconds back/forward
+  Up/Down              Volume up/down
+  h                    Show/hide the stats line
+  ESC or q             Stop
 
 Examples:
   play -v video.mp4 -ct dy -c l
@@ -163,12 +213,34 @@ Examples:
       Set a default video path to 'default.mp4' for future playback commands.
   set -ct dy
       Set dynamic contrast as the default mode for future playback commands.
+  set -j 8
+      Convert every frame on 8 threads from now on, "save" keeps it for the next start.
+  play -v video.mp4 -cm trueh
+      Play 'video.mp4' in 24-bit color with half blocks.
+  set -ad
+      Let every playback trade quality for smoothness on slow machines from now on.
+  play -v video.mp4 -ct br -dt
+      Play 'video.mp4' as dithered Braille dots.
+  bench -v video.mp4 -size 300x80 -frames 1000
+      Convert the first 1000 frames for a 300x80 terminal as fast as possible and report timings.
+  ffmpeg -i input.mkv -f matroska - | CMD-Video-Player -v - -cm 256
+      Play whatever another program writes to the pipe, without a temporary file.
+  play -v kiosk -loop
+      Play every video in the folder 'kiosk' by name, over and over, without gaps between the clips.
+  export -v video.mp4 -o video.cva -size 160x48
+      Convert 'video.mp4' once, then 'play -v video.cva' replays it without decoding.
+  serve -v video.mp4 -l tcp:7000 -sizes 160x48,80x24
+      Decode 'video.mp4' once and show it on every terminal that runs 'watch -l tcp:7000' (video only).
 
 Additional commands:
   help               Show this help message
   exit               Exit the program
   set                Set default options (e.g., video path, contrast mode)
   save               Save the default options to a configuration file
+  bench              Measure decode/resize/ASCII/output timings without a terminal or audio
+  export             Save a video as pre-converted ASCII frames (played silently)
+  serve              Decode a video once and stream it to every terminal that watches (video only)
+  watch              Show what a serve command streams, sized to this terminal
 )";
     }
 }
@@ -246,7 +318,8 @@ cmdOptions parseArguments(const std::pair<int, const char **> &args, const char
         if (arg == self_name)
             continue;
         if (arg[0] == '-') { // option starts with '-'
-            if (i + 1 < argc && argv[i + 1][0] != '-') {
+            // A lone "-" is a value (stdin), not another option
+            if (i + 1 < argc && (argv[i + 1][0] != '-' || std::string(argv[i + 1]) == "-")) {
                 // Check if there's a value following or not
                 cmdOptions.options[arg] = argv[++i];
             } else {
@@ -268,3 +341,17 @@ void print_error(std::string error_name, std::string error_detail) {
               << "Press any key to continue..." << std::endl;
     getchar();
 }
+
+// Parses a WIDTHxHEIGHT terminal size such as "200x60"
+bool parse_size_param(const std::string &value, int &width, int &height) {
+    size_t x_pos = value.find('x');
+    if (x_pos == std::string::npos)
+        return false;
+    try {
+        width = std::stoi(value.substr(0, x_pos));
+        height = std::stoi(value.substr(x_pos + 1));
+    } catch (const std::exception &) {
+        return false;
+    }
+    return width > 0 && height > 2;
+}
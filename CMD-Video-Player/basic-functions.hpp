@@ -41,6 +41,7 @@ void printMap(const std::map<K, V> &m) {
 
 void get_terminal_size(int &width, int &height);
 std::string get_system_type();
+std::string get_config_file_path();
 void save_default_options_to_file(std::map<std::string, std::string> &default_options);
 void load_default_options_from_file(std::map<std::string, std::string> &default_options);
 void show_interface();
@@ -49,5 +50,6 @@ void clear_screen();
 std::pair<int, const char**> parseCommandLine(const std::string &str);
 cmdOptions parseArguments(const std::pair<int, const char**>& args, const char* self_name);
 void print_error(std::string error_name, std::string error_detail = "");
+bool parse_size_param(const std::string &value, int &width, int &height);
 
 #endif /* basic_functions_hpp */
@@ -0,0 +1,229 @@
+//
+//  benchmark.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "benchmark.hpp"
+#include "basic-functions.hpp"
+#include "video-player.hpp"
+
+#define DEFAULT_BENCH_WIDTH 200
+#define DEFAULT_BENCH_HEIGHT 60
+
+typedef std::chrono::steady_clock bench_clock;
+
+struct StageSamples {
+    const char *name;
+    std::vector<double> ms;
+};
+
+static double elapsed_ms(bench_clock::time_point start, bench_clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const std::vector<double> &sorted, double p) {
+    if (sorted.empty())
+        return 0;
+    size_t rank = static_cast<size_t>(std::ceil(p / 100.0 * sorted.size()));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+static void print_stage(StageSamples &stage) {
+    std::sort(stage.ms.begin(), stage.ms.end());
+    double total = 0;
+    for (double ms : stage.ms)
+        total += ms;
+    double mean = stage.ms.empty() ? 0 : total / stage.ms.size();
+    std::cout << std::left << std::setw(16) << stage.name << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << percentile(stage.ms, 50)
+              << std::setw(10) << percentile(stage.ms, 95)
+              << std::setw(10) << percentile(stage.ms, 99)
+              << std::setw(10) << mean << std::endl;
+}
+
+void run_benchmark(const std::map<std::string, std::string> &params) {
+    if (!params_include(params, "-v")) {
+        print_error("Nothing to benchmark", "Add a -v param, or type \"help\" to get usage");
+        return;
+    }
+    std::string video_path = params.at("-v");
+    AsciiFunc generate_ascii_func = select_ascii_func(params);
+    CellSampling sampling = select_cell_sampling(params);
+    resize_band_pool(select_band_threads(params) - 1);
+    const char *frame_chars = select_frame_chars(params);
+    ColorMode color_mode = select_color_mode(params);
+    bool colored = color_mode.depth != COLOR_DEPTH_NONE;
+
+    int term_width = DEFAULT_BENCH_WIDTH, term_height = DEFAULT_BENCH_HEIGHT;
+    if (params_include(params, "-size") && !parse_size_param(params.at("-size"), term_width, term_height)) {
+        print_error("Invalid -size value, expected WIDTHxHEIGHT", params.at("-size"));
+        return;
+    }
+    long max_frames = 0;
+    if (params_include(params, "-frames")) {
+        try {
+            max_frames = std::stol(params.at("-frames"));
+        } catch (const std::exception &) {
+            print_error("Invalid -frames value", params.at("-frames"));
+            return;
+        }
+    }
+
+    // Bytes go to a file such as /dev/null when -o is given, otherwise they are only counted
+    FILE *sink = nullptr;
+    if (params_include(params, "-o")) {
+        sink = fopen(params.at("-o").c_str(), "wb");
+        if (!sink) {
+            print_error("Error: Could not open benchmark output", params.at("-o"));
+            return;
+        }
+    }
+
+    // Opened like a playback, so -mm and -ib compare the input backends as well
+    MediaInput input;
+    std::string error;
+    bool full_decode = params_include(params, "-fd");
+    if (!open_media_input(video_path, full_decode ? 0 : term_width, full_decode ? 0 : term_height, input, error,
+                          select_input_options(params))) {
+        print_error(error, video_path);
+        if (sink)
+            fclose(sink);
+        return;
+    }
+    AVFormatContext *format_ctx = input.format_ctx;
+    AVCodecContext *video_codec_ctx = input.video_codec_ctx;
+    int video_stream_index = input.video_stream_index;
+    AVStream *video_stream = format_ctx->streams[video_stream_index];
+    const char *input_backend = input.pipe ? "pipe read-ahead" : input.mapped ? "mmap" : "file protocol";
+    int64_t total_duration = format_ctx->duration / AV_TIME_BASE;
+
+    StageSamples read_stage = {"read", {}};
+    StageSamples decode_stage = {"decode", {}};
+    StageSamples scale_stage = {"scale", {}};
+    StageSamples glyph_stage = {"glyphs", {}};
+    StageSamples color_stage = {"color", {}};
+    StageSamples output_stage = {"output", {}};
+    std::vector<double> frame_bytes;
+
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    LumaScaler luma_scaler;
+    cv::Mat scaled_frame;
+    GlyphGrid grid;
+    ColorSampler color_sampler;
+    TerminalRenderer renderer;
+    OutputBuffer terminal_output;
+    double pending_read_ms = 0;   // demuxer time not yet attributed to a frame
+    double pending_decode_ms = 0; // decoder time not yet attributed to a frame
+    long frame_count = 0;
+    bool draining = false;
+
+    auto bench_start = bench_clock::now();
+    while (!max_frames || frame_count < max_frames) {
+        if (!draining) {
+            auto read_start = bench_clock::now();
+            int ret = av_read_frame(format_ctx, packet);
+            auto decode_start = bench_clock::now();
+            pending_read_ms += elapsed_ms(read_start, decode_start);
+            if (ret < 0) {
+                draining = true;
+                avcodec_send_packet(video_codec_ctx, NULL);
+            } else if (packet->stream_index != video_stream_index) {
+                av_packet_unref(packet);
+                continue;
+            } else {
+                avcodec_send_packet(video_codec_ctx, packet);
+                av_packet_unref(packet);
+            }
+            pending_decode_ms += elapsed_ms(decode_start, bench_clock::now());
+        }
+
+        bool got_frame = false;
+        while (!max_frames || frame_count < max_frames) {
+            auto receive_start = bench_clock::now();
+            int ret = avcodec_receive_frame(video_codec_ctx, frame);
+            auto scale_start = bench_clock::now();
+            pending_decode_ms += elapsed_ms(receive_start, scale_start);
+            if (ret < 0)
+                break;
+            got_frame = true;
+            read_stage.ms.push_back(pending_read_ms);
+            decode_stage.ms.push_back(pending_decode_ms);
+            pending_read_ms = pending_decode_ms = 0;
+
+            // Same steps as a conversion worker, timed one by one
+            FrameLayout layout = compute_frame_layout(frame->width, frame->height, term_width, term_height - 2);
+            bool has_picture = layout.frame_width > 0 && layout.frame_height > 0;
+            if (has_picture && !color_mode.half_block)
+                has_picture = luma_scaler.scale(frame, layout.frame_width * sampling.sub_x, layout.frame_height * sampling.sub_y, scaled_frame);
+            auto glyph_start = bench_clock::now();
+            scale_stage.ms.push_back(elapsed_ms(scale_start, glyph_start));
+
+            grid.reset(term_width, term_height - 1, colored, sampling.wide_glyphs);
+            if (has_picture && !color_mode.half_block)
+                generate_ascii_func(scaled_frame, grid, layout.left, layout.top, frame_chars);
+            auto color_start = bench_clock::now();
+            glyph_stage.ms.push_back(elapsed_ms(glyph_start, color_start));
+
+            if (has_picture && colored)
+                color_sampler.colorize(frame, color_mode, layout.left, layout.top, layout.frame_width, layout.frame_height, grid);
+            auto output_start = bench_clock::now();
+            color_stage.ms.push_back(elapsed_ms(color_start, output_start));
+
+            int64_t pts = frame->best_effort_timestamp == AV_NOPTS_VALUE ? 0 : frame->best_effort_timestamp;
+            draw_status_line(grid, "", static_cast<int64_t>(pts * av_q2d(video_stream->time_base)), total_duration);
+            terminal_output.clear();
+            renderer.render(grid, terminal_output);
+            if (sink)
+                terminal_output.write_to(sink);
+            output_stage.ms.push_back(elapsed_ms(output_start, bench_clock::now()));
+            frame_bytes.push_back(static_cast<double>(terminal_output.size()));
+
+            frame_count++;
+        }
+        if (draining && !got_frame)
+            break;
+    }
+    double total_seconds = elapsed_ms(bench_start, bench_clock::now()) / 1000.0;
+    int decoder_threads = video_codec_ctx->thread_count, decoder_lowres = video_codec_ctx->lowres;
+    bool skip_loop_filter = video_codec_ctx->skip_loop_filter == AVDISCARD_ALL;
+
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    close_media_input(input);
+    if (sink)
+        fclose(sink);
+
+    std::ios_base::fmtflags cout_flags = std::cout.flags();
+    std::streamsize cout_precision = std::cout.precision();
+    std::cout << "\n====== Benchmark: " << video_path << " ======\n";
+    std::cout << "Virtual terminal: " << term_width << "x" << term_height
+              << ", glyph kernel: " << glyph_kernel_name() << ", color: "
+              << (colored ? (color_mode.depth == COLOR_DEPTH_256 ? "256" : "24-bit") : "none")
+              << (color_mode.half_block ? " half blocks" : "") << std::endl;
+    std::cout << "Input: " << input_backend << std::endl;
+    std::cout << "Band threads per frame: " << band_pool().size() + 1 << std::endl;
+    std::cout << "Decoder: " << decoder_threads << " threads, lowres " << decoder_lowres
+              << (skip_loop_filter ? ", loop filter skipped" : "") << std::endl;
+    std::cout << "Frames: " << frame_count << " in " << std::fixed << std::setprecision(3) << total_seconds << " s ("
+              << std::setprecision(1) << (total_seconds > 0 ? frame_count / total_seconds : 0) << " fps)" << std::endl;
+    std::cout << std::left << std::setw(16) << "stage (ms)" << std::right
+              << std::setw(10) << "p50" << std::setw(10) << "p95" << std::setw(10) << "p99" << std::setw(10) << "mean" << std::endl;
+    for (StageSamples *stage : {&read_stage, &decode_stage, &scale_stage, &glyph_stage, &color_stage, &output_stage}) {
+        print_stage(*stage);
+    }
+
+    std::sort(frame_bytes.begin(), frame_bytes.end());
+    double total_bytes = 0;
+    for (double bytes : frame_bytes)
+        total_bytes += bytes;
+    std::cout << std::setprecision(0) << "Bytes per frame: mean " << (frame_bytes.empty() ? 0 : total_bytes / frame_bytes.size())
+              << ", p50 " << percentile(frame_bytes, 50) << ", p99 " << percentile(frame_bytes, 99)
+              << ", max " << (frame_bytes.empty() ? 0 : frame_bytes.back()) << std::endl;
+    std::cout << "======================================\n";
+    std::cout.flags(cout_flags);
+    std::cout.precision(cout_precision);
+}
@@ -0,0 +1,18 @@
+//
+//  benchmark.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef benchmark_hpp
+#define benchmark_hpp
+
+#include <map>
+#include <string>
+
+// Runs decode -> resize -> ASCII -> output assembly as fast as possible against a
+// virtual terminal, without audio or a real terminal, and prints per-stage timings.
+void run_benchmark(const std::map<std::string, std::string> &params);
+
+#endif /* benchmark_hpp */
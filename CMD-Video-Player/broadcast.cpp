@@ -0,0 +1,662 @@
+//
+//  broadcast.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "broadcast.hpp"
+#include "basic-functions.hpp"
+#include "video-player.hpp"
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#define BROADCAST_IO_POLL_MS 100         // how often blocked socket I/O looks at the stop flag
+#define BROADCAST_HELLO_TIMEOUT_MS 2000  // a client that says nothing for this long is dropped
+#define BROADCAST_DRAIN_TIMEOUT_MS 2000  // after the last frame, clients get this long to take it
+#define BROADCAST_LATE_FRAME 0.1         // seconds behind after which the server skips a frame
+
+// The client's own terminal setup, the frames themselves only ever move the cursor and draw
+#define TERMINAL_PREPARE "\033[?25l\033[2J\033[H" // hide the cursor, clear
+#define TERMINAL_CLEAR "\033[2J\033[H"
+#define TERMINAL_RESTORE "\033[0m\033[?25h"      // default colors, show the cursor
+
+#ifdef _WIN32
+
+void run_broadcast_server(const std::map<std::string, std::string> &params) {
+    print_error("serve is not available on Windows");
+}
+
+void run_broadcast_client(const std::map<std::string, std::string> &params) {
+    print_error("watch is not available on Windows");
+}
+
+#else
+
+struct BroadcastAddress {
+    bool tcp = false;
+    std::string host; // tcp
+    std::string port;
+    std::string path; // unix
+};
+
+static bool parse_broadcast_address(const std::string &value, BroadcastAddress &address) {
+    if (value.rfind("tcp:", 0) == 0) {
+        std::string rest = value.substr(4);
+        size_t colon = rest.rfind(':');
+        address.tcp = true;
+        address.host = colon == std::string::npos ? "127.0.0.1" : rest.substr(0, colon);
+        address.port = colon == std::string::npos ? rest : rest.substr(colon + 1);
+        return !address.port.empty() && address.port.find_first_not_of("0123456789") == std::string::npos;
+    }
+    address.path = value.rfind("unix:", 0) == 0 ? value.substr(5) : value;
+    return !address.path.empty() && address.path.size() < sizeof(sockaddr_un::sun_path);
+}
+
+static void configure_socket(int fd, bool tcp) {
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    if (tcp) {
+        // Frames are written in one piece and waited on, Nagle would only add latency
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    }
+}
+
+static int open_socket(const BroadcastAddress &address, bool listening, std::string &error) {
+    if (!address.tcp) {
+        sockaddr_un local = {};
+        local.sun_family = AF_UNIX;
+        memcpy(local.sun_path, address.path.c_str(), address.path.size());
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) {
+            error = "Error: Could not create socket";
+            return -1;
+        }
+        configure_socket(fd, false);
+        if (listening) {
+            // A socket file left behind by an earlier server would make bind fail
+            struct stat st;
+            if (stat(address.path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+                unlink(address.path.c_str());
+            if (bind(fd, reinterpret_cast<sockaddr *>(&local), sizeof(local)) < 0 || listen(fd, SOMAXCONN) < 0) {
+                close(fd);
+                error = "Error: Could not listen on socket";
+                return -1;
+            }
+        } else if (connect(fd, reinterpret_cast<sockaddr *>(&local), sizeof(local)) < 0) {
+            close(fd);
+            error = "Error: Could not connect to socket";
+            return -1;
+        }
+        return fd;
+    }
+
+    addrinfo hints = {}, *results = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(address.host.c_str(), address.port.c_str(), &hints, &results) != 0) {
+        error = "Error: Could not resolve address";
+        return -1;
+    }
+    int fd = -1;
+    for (addrinfo *candidate = results; candidate && fd < 0; candidate = candidate->ai_next) {
+        fd = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+        if (fd < 0)
+            continue;
+        configure_socket(fd, true);
+        bool ok;
+        if (listening) {
+            int reuse = 1;
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            ok = bind(fd, candidate->ai_addr, candidate->ai_addrlen) == 0 && listen(fd, SOMAXCONN) == 0;
+        } else {
+            ok = connect(fd, candidate->ai_addr, candidate->ai_addrlen) == 0;
+        }
+        if (!ok) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(results);
+    if (fd < 0)
+        error = listening ? "Error: Could not listen on address" : "Error: Could not connect to address";
+    return fd;
+}
+
+// Sends all of data, false once the peer is gone
+static bool send_all(int fd, const void *data, size_t size) {
+#ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t n = send(fd, bytes, size, flags);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Receives exactly size bytes. Gives up when stop is raised, the peer is gone,
+// or nothing arrives for timeout_ms (0 waits as long as it takes).
+static bool receive_all(int fd, void *data, size_t size, const std::atomic<bool> &stop, int timeout_ms = 0) {
+    char *bytes = static_cast<char *>(data);
+    int waited_ms = 0;
+    while (size > 0) {
+        if (stop)
+            return false;
+        struct pollfd waiting = {fd, POLLIN, 0};
+        int ready = poll(&waiting, 1, BROADCAST_IO_POLL_MS);
+        if (ready < 0 && errno != EINTR)
+            return false;
+        if (ready <= 0) {
+            waited_ms += BROADCAST_IO_POLL_MS;
+            if (timeout_ms && waited_ms >= timeout_ms)
+                return false;
+            continue;
+        }
+        ssize_t n = recv(fd, bytes, size, 0);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+        if (n <= 0)
+            return false;
+        bytes += n;
+        size -= n;
+        waited_ms = 0;
+    }
+    return true;
+}
+
+// One terminal size the video is converted for, shared by every client that got it
+struct Rendition {
+    int width = 0;
+    int height = 0;
+    // Newest frame, replaced under BroadcastServer::mutex
+    std::shared_ptr<const GlyphGrid> frame;
+    uint32_t sequence = 0;
+
+    // Only used by the converting thread
+    LumaScaler luma_scaler;
+    cv::Mat scaled_frame;
+    ColorSampler color_sampler;
+    // Grids no client holds any more are reused. Sessions drop their references under
+    // BroadcastServer::mutex and the pool is only searched under it.
+    std::vector<std::shared_ptr<GlyphGrid>> pool;
+};
+
+struct ClientSession {
+    int fd = -1;
+    std::thread thread;
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> frames_sent{0};
+    std::atomic<uint64_t> frames_skipped{0};
+};
+
+struct BroadcastServer {
+    std::vector<std::unique_ptr<Rendition>> renditions;
+    std::mutex mutex;
+    std::condition_variable frame_ready;
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> finished{false}; // no more frames after the current ones
+
+    std::mutex clients_mutex;
+    std::vector<std::unique_ptr<ClientSession>> clients;
+};
+
+// The largest rendition that fits on the client's terminal, or the smallest one if none does
+static Rendition &choose_rendition(BroadcastServer &server, int width, int height) {
+    Rendition *best = nullptr, *smallest = nullptr;
+    for (auto &rendition : server.renditions) {
+        int area = rendition->width * rendition->height;
+        if (!smallest || area < smallest->width * smallest->height)
+            smallest = rendition.get();
+        if (rendition->width <= width && rendition->height <= height && (!best || area > best->width * best->height))
+            best = rendition.get();
+    }
+    return best ? *best : *smallest;
+}
+
+static void client_session_func(BroadcastServer &server, ClientSession &session) {
+    BroadcastHello hello;
+    if (!receive_all(session.fd, &hello, sizeof(hello), server.stopping, BROADCAST_HELLO_TIMEOUT_MS) ||
+        memcmp(hello.magic, BROADCAST_HELLO_MAGIC, sizeof(hello.magic)) != 0 || hello.version != BROADCAST_VERSION) {
+        session.done = true;
+        return;
+    }
+    Rendition &rendition = choose_rendition(server, static_cast<int>(hello.width), static_cast<int>(hello.height));
+    BroadcastWelcome welcome = {};
+    memcpy(welcome.magic, BROADCAST_WELCOME_MAGIC, sizeof(welcome.magic));
+    welcome.version = BROADCAST_VERSION;
+    welcome.width = rendition.width;
+    welcome.height = rendition.height;
+    if (!send_all(session.fd, &welcome, sizeof(welcome))) {
+        session.done = true;
+        return;
+    }
+
+    // What this client's screen shows is exactly the last frame it acknowledged
+    TerminalRenderer renderer;
+    OutputBuffer output;
+    uint32_t sent_sequence = 0;
+    while (true) {
+        std::shared_ptr<const GlyphGrid> frame;
+        uint32_t sequence;
+        {
+            std::unique_lock<std::mutex> lock(server.mutex);
+            server.frame_ready.wait(lock, [&] {
+                return server.stopping || server.finished || (rendition.frame && rendition.sequence != sent_sequence);
+            });
+            if (server.stopping)
+                break;
+            if (!rendition.frame || rendition.sequence == sent_sequence) {
+                BroadcastFrameHeader end = {sent_sequence, 0, BROADCAST_FRAME_END, 0};
+                send_all(session.fd, &end, sizeof(end));
+                break;
+            }
+            frame = rendition.frame;
+            sequence = rendition.sequence;
+        }
+        if (sent_sequence)
+            session.frames_skipped += sequence - sent_sequence - 1;
+
+        output.clear();
+        renderer.render(*frame, output);
+        {
+            // Released under the lock, so the converter sees every read of the grid done before it reuses it
+            std::lock_guard<std::mutex> lock(server.mutex);
+            frame.reset();
+        }
+        BroadcastFrameHeader header = {sequence, static_cast<uint32_t>(output.size()), 0, 0};
+        if (!send_all(session.fd, &header, sizeof(header)) || !send_all(session.fd, output.data(), output.size()))
+            break;
+        sent_sequence = sequence;
+        session.frames_sent++;
+
+        BroadcastAck ack;
+        if (!receive_all(session.fd, &ack, sizeof(ack), server.stopping))
+            break;
+        if (ack.flags & BROADCAST_ACK_REDRAW)
+            renderer.invalidate();
+    }
+    session.done = true;
+}
+
+static void accept_thread_func(BroadcastServer &server, int listen_fd, bool tcp) {
+    while (!server.stopping) {
+        struct pollfd waiting = {listen_fd, POLLIN, 0};
+        if (poll(&waiting, 1, BROADCAST_IO_POLL_MS) <= 0)
+            continue;
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0)
+            continue;
+        configure_socket(fd, tcp);
+
+        std::lock_guard<std::mutex> lock(server.clients_mutex);
+        // 回收已经断开的客户端
+        for (auto it = server.clients.begin(); it != server.clients.end();) {
+            if ((*it)->done) {
+                (*it)->thread.join();
+                close((*it)->fd);
+                it = server.clients.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        auto session = std::make_unique<ClientSession>();
+        session->fd = fd;
+        session->thread = std::thread(client_session_func, std::ref(server), std::ref(*session));
+        server.clients.push_back(std::move(session));
+    }
+}
+
+static bool parse_renditions(const std::map<std::string, std::string> &params, BroadcastServer &server) {
+    // Without -sizes or -size, clients get what fits on the server's own terminal
+    int term_width, term_height;
+    get_terminal_size(term_width, term_height);
+    std::string sizes = params_include(params, "-sizes") ? params.at("-sizes")
+                        : params_include(params, "-size") ? params.at("-size")
+                                                          : std::to_string(term_width) + "x" + std::to_string(term_height);
+    std::stringstream list(sizes);
+    std::string size;
+    while (std::getline(list, size, ',')) {
+        auto rendition = std::make_unique<Rendition>();
+        if (!parse_size_param(size, rendition->width, rendition->height) || rendition->height < 3) {
+            print_error("Invalid -sizes value, expected WIDTHxHEIGHT[,WIDTHxHEIGHT...]", sizes);
+            return false;
+        }
+        server.renditions.push_back(std::move(rendition));
+    }
+    return !server.renditions.empty();
+}
+
+// Same steps as a playback's convert_frame, for the rendition's fixed terminal size
+static std::shared_ptr<GlyphGrid> convert_for_rendition(BroadcastServer &server, Rendition &rendition, const AVFrame *frame,
+                                                        const AsciiFunc &ascii_func, const CellSampling &sampling,
+                                                        ColorMode color_mode, const char *frame_chars) {
+    std::shared_ptr<GlyphGrid> grid;
+    {
+        std::lock_guard<std::mutex> lock(server.mutex);
+        for (auto &candidate : rendition.pool) {
+            // Only the pool holds it: no client is sending it and it is not the newest frame
+            if (candidate.use_count() == 1) {
+                grid = candidate;
+                break;
+            }
+        }
+    }
+    if (!grid) {
+        grid = std::make_shared<GlyphGrid>();
+        rendition.pool.push_back(grid);
+    }
+
+    bool colored = color_mode.depth != COLOR_DEPTH_NONE;
+    FrameLayout layout = compute_frame_layout(frame->width, frame->height, rendition.width, rendition.height - 2);
+    grid->reset(rendition.width, rendition.height - 1, colored, sampling.wide_glyphs);
+    if (layout.frame_width > 0 && layout.frame_height > 0) {
+        if (!color_mode.half_block &&
+            rendition.luma_scaler.scale(frame, layout.frame_width * sampling.sub_x, layout.frame_height * sampling.sub_y, rendition.scaled_frame))
+            ascii_func(rendition.scaled_frame, *grid, layout.left, layout.top, frame_chars);
+        if (colored)
+            rendition.color_sampler.colorize(frame, color_mode, layout.left, layout.top, layout.frame_width, layout.frame_height, *grid);
+    }
+    return grid;
+}
+
+static void stop_clients(BroadcastServer &server) {
+    // Wake up everything that waits for a frame or blocks in a socket call
+    {
+        std::lock_guard<std::mutex> lock(server.mutex);
+        server.stopping = true;
+    }
+    server.frame_ready.notify_all();
+    std::lock_guard<std::mutex> lock(server.clients_mutex);
+    for (auto &session : server.clients) {
+        shutdown(session->fd, SHUT_RDWR);
+        session->thread.join();
+        close(session->fd);
+    }
+    server.clients.clear();
+}
+
+void run_broadcast_server(const std::map<std::string, std::string> &params) {
+    if (!params_include(params, "-v") || !params_include(params, "-l")) {
+        print_error("Nothing to serve", "Add -v and -l params, or type \"help\" to get usage");
+        return;
+    }
+    BroadcastAddress address;
+    if (!parse_broadcast_address(params.at("-l"), address)) {
+        print_error("Invalid -l value, expected unix:/path or tcp:[host:]port", params.at("-l"));
+        return;
+    }
+    BroadcastServer server;
+    if (!parse_renditions(params, server))
+        return;
+
+    std::string video_path = params.at("-v");
+    AsciiFunc ascii_func = select_ascii_func(params);
+    CellSampling sampling = select_cell_sampling(params);
+    ColorMode color_mode = select_color_mode(params);
+    const char *frame_chars = select_frame_chars(params);
+    resize_band_pool(select_band_threads(params) - 1);
+
+    // Decoded for the largest rendition, the smaller ones scale down from there
+    int max_width = 0, max_height = 0;
+    for (auto &rendition : server.renditions) {
+        max_width = std::max(max_width, rendition->width);
+        max_height = std::max(max_height, rendition->height);
+    }
+    MediaInput input;
+    std::string error;
+    bool full_decode = params_include(params, "-fd");
+    if (!open_media_input(video_path, full_decode ? 0 : max_width, full_decode ? 0 : max_height, input, error,
+                          select_input_options(params))) {
+        print_error(error, video_path);
+        return;
+    }
+    int listen_fd = open_socket(address, true, error);
+    if (listen_fd < 0) {
+        close_media_input(input);
+        print_error(error, params.at("-l"));
+        return;
+    }
+
+    AVFormatContext *format_ctx = input.format_ctx;
+    AVStream *video_stream = format_ctx->streams[input.video_stream_index];
+    int64_t total_duration = format_ctx->duration > 0 ? format_ctx->duration / AV_TIME_BASE : 0;
+    // The status line counts from the start of the video, not from pts 0
+    double start_time = video_stream->start_time != AV_NOPTS_VALUE ? video_stream->start_time * av_q2d(video_stream->time_base) : 0;
+    std::cout << "Serving " << video_path << " on " << params.at("-l") << " (" << server.renditions.size()
+              << " renditions), press q or ESC to stop" << std::endl;
+
+    std::thread accept_thread(accept_thread_func, std::ref(server), listen_fd, address.tcp);
+    TerminalInput terminal_input;
+    terminal_input.start();
+    PlayerCommand command;
+
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    auto start = std::chrono::steady_clock::now();
+    double first_pts = -1;
+    int64_t last_report = -1;
+    bool draining = false, quit = false;
+    while (!quit) {
+        // Video only: the clients are terminals
+        if (!draining) {
+            int ret = av_read_frame(format_ctx, packet);
+            if (ret < 0) {
+                draining = true;
+                avcodec_send_packet(input.video_codec_ctx, NULL);
+            } else if (packet->stream_index != input.video_stream_index) {
+                av_packet_unref(packet);
+                continue;
+            } else {
+                avcodec_send_packet(input.video_codec_ctx, packet);
+                av_packet_unref(packet);
+            }
+        }
+
+        bool got_frame = false;
+        while (!quit && avcodec_receive_frame(input.video_codec_ctx, frame) >= 0) {
+            got_frame = true;
+            while (terminal_input.poll(command)) {
+                quit = quit || command == COMMAND_QUIT;
+            }
+
+            // Paced in real time like a playback, every client sees the same moment
+            int64_t timestamp = frame->best_effort_timestamp == AV_NOPTS_VALUE ? 0 : frame->best_effort_timestamp;
+            double pts = std::max(timestamp * av_q2d(video_stream->time_base), 0.0);
+            if (first_pts < 0)
+                first_pts = pts;
+            double delay = (pts - first_pts) - std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (delay < -BROADCAST_LATE_FRAME)
+                continue;
+            if (delay > 0)
+                std::this_thread::sleep_for(std::chrono::duration<double>(std::min(delay, 1.0)));
+
+            for (auto &rendition : server.renditions) {
+                std::shared_ptr<GlyphGrid> grid = convert_for_rendition(server, *rendition, frame, ascii_func, sampling, color_mode, frame_chars);
+                draw_status_line(*grid, "", static_cast<int64_t>(std::max(pts - start_time, 0.0)), total_duration);
+                std::lock_guard<std::mutex> lock(server.mutex);
+                rendition->frame = grid;
+                rendition->sequence++;
+            }
+            server.frame_ready.notify_all();
+
+            if (static_cast<int64_t>(pts) != last_report) {
+                last_report = static_cast<int64_t>(pts);
+                size_t clients = 0;
+                uint64_t skipped = 0;
+                {
+                    std::lock_guard<std::mutex> lock(server.clients_mutex);
+                    for (auto &session : server.clients) {
+                        clients += !session->done;
+                        skipped += session->frames_skipped;
+                    }
+                }
+                std::cout << "\r" << clients << " clients, " << last_report << "/" << total_duration << " s, "
+                          << skipped << " frames skipped by slow clients   " << std::flush;
+            }
+        }
+        if (draining && !got_frame)
+            break;
+    }
+    std::cout << std::endl;
+
+    // Let the clients take the last frame and the end marker, unless the server was stopped
+    {
+        std::lock_guard<std::mutex> lock(server.mutex);
+        server.finished = true;
+    }
+    server.frame_ready.notify_all();
+    for (int waited_ms = 0; !quit && waited_ms < BROADCAST_DRAIN_TIMEOUT_MS; waited_ms += BROADCAST_IO_POLL_MS) {
+        bool all_done = true;
+        {
+            std::lock_guard<std::mutex> lock(server.clients_mutex);
+            for (auto &session : server.clients)
+                all_done = all_done && session->done;
+        }
+        if (all_done)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(BROADCAST_IO_POLL_MS));
+    }
+    stop_clients(server);
+    accept_thread.join();
+    stop_clients(server); // anyone accepted while the first round was stopping
+    terminal_input.stop();
+
+    close(listen_fd);
+    if (!address.tcp)
+        unlink(address.path.c_str());
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    close_media_input(input);
+    std::cout << "Broadcast finished." << std::endl;
+}
+
+// Writes everything to the terminal, the payload is ready-made escape sequences
+static bool write_terminal(const char *data, size_t size) {
+    fflush(stdout);
+    while (size > 0) {
+        ssize_t n = write(STDOUT_FILENO, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+void run_broadcast_client(const std::map<std::string, std::string> &params) {
+    if (!params_include(params, "-l")) {
+        print_error("Nothing to watch", "Add a -l param, or type \"help\" to get usage");
+        return;
+    }
+    BroadcastAddress address;
+    if (!parse_broadcast_address(params.at("-l"), address)) {
+        print_error("Invalid -l value, expected unix:/path or tcp:[host:]port", params.at("-l"));
+        return;
+    }
+    std::string error;
+    int fd = open_socket(address, false, error);
+    if (fd < 0) {
+        print_error(error, params.at("-l"));
+        return;
+    }
+
+    int term_width, term_height;
+    get_terminal_size(term_width, term_height);
+    if (params_include(params, "-size") && !parse_size_param(params.at("-size"), term_width, term_height)) {
+        close(fd);
+        print_error("Invalid -size value, expected WIDTHxHEIGHT", params.at("-size"));
+        return;
+    }
+    BroadcastHello hello = {};
+    memcpy(hello.magic, BROADCAST_HELLO_MAGIC, sizeof(hello.magic));
+    hello.version = BROADCAST_VERSION;
+    hello.width = term_width;
+    hello.height = term_height;
+    std::atomic<bool> stop{false};
+    BroadcastWelcome welcome;
+    if (!send_all(fd, &hello, sizeof(hello)) ||
+        !receive_all(fd, &welcome, sizeof(welcome), stop, BROADCAST_HELLO_TIMEOUT_MS) ||
+        memcmp(welcome.magic, BROADCAST_WELCOME_MAGIC, sizeof(welcome.magic)) != 0 || welcome.version != BROADCAST_VERSION) {
+        close(fd);
+        print_error("Error: No broadcast server answered", params.at("-l"));
+        return;
+    }
+
+    TerminalInput terminal_input;
+    terminal_input.start();
+    write_terminal(TERMINAL_PREPARE, strlen(TERMINAL_PREPARE));
+    PlayerCommand command;
+    std::vector<char> payload; // only ever grows
+    bool ended = false, quit = false;
+    int prev_width = term_width, prev_height = term_height;
+    while (!quit) {
+        while (terminal_input.poll(command)) {
+            quit = quit || command == COMMAND_QUIT;
+        }
+        struct pollfd waiting = {fd, POLLIN, 0};
+        int ready = poll(&waiting, 1, BROADCAST_IO_POLL_MS);
+        if (ready == 0 || (ready < 0 && errno == EINTR))
+            continue;
+
+        BroadcastFrameHeader header;
+        if (ready < 0 || !receive_all(fd, &header, sizeof(header), stop))
+            break;
+        if (header.flags & BROADCAST_FRAME_END) {
+            ended = true;
+            break;
+        }
+        if (payload.size() < header.size)
+            payload.resize(header.size);
+        if (!receive_all(fd, payload.data(), header.size, stop) || !write_terminal(payload.data(), header.size))
+            break;
+
+        // A resized terminal lost what was on it: clear what is left around the rendition,
+        // the server sends the next frame in full
+        BroadcastAck ack = {header.sequence, 0};
+        get_terminal_size(term_width, term_height);
+        if (term_width != prev_width || term_height != prev_height) {
+            prev_width = term_width;
+            prev_height = term_height;
+            write_terminal(TERMINAL_CLEAR, strlen(TERMINAL_CLEAR));
+            ack.flags |= BROADCAST_ACK_REDRAW;
+        }
+        if (!send_all(fd, &ack, sizeof(ack)))
+            break;
+    }
+    write_terminal(TERMINAL_RESTORE, strlen(TERMINAL_RESTORE));
+    terminal_input.stop();
+    close(fd);
+
+    clear_screen();
+    if (quit)
+        std::cout << "Stopped watching.\n";
+    else if (ended)
+        std::cout << "Broadcast ended.\n";
+    else
+        std::cout << "Connection to the broadcast server lost.\n";
+}
+
+#endif
@@ -0,0 +1,69 @@
+//
+//  broadcast.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef broadcast_hpp
+#define broadcast_hpp
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+// serve decodes and converts a video once per rendition (terminal size) and streams it to any
+// number of watch clients over a Unix domain socket or localhost TCP. Every client gets the
+// escape sequences that bring its own screen up to date, so a client only writes them out.
+//
+// Protocol, all fields little endian:
+//   client -> server  BroadcastHello (its terminal size)
+//   server -> client  BroadcastWelcome (the rendition it was given)
+//   server -> client  BroadcastFrameHeader | size bytes of terminal output
+//   client -> server  BroadcastAck once those bytes are written
+// The next frame is only sent after the ack, as a diff against the acknowledged one.
+// Frames published meanwhile are skipped, so a slow client never holds up the others.
+#define BROADCAST_HELLO_MAGIC "CVPWATCH"
+#define BROADCAST_WELCOME_MAGIC "CVPSERVE"
+#define BROADCAST_VERSION 1
+
+enum BroadcastFlags : uint32_t {
+    BROADCAST_FRAME_END = 1,  // frame header: the stream is over, no payload follows
+    BROADCAST_ACK_REDRAW = 1, // ack: the client's terminal was resized, send the next frame in full
+};
+
+struct BroadcastHello {
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+};
+static_assert(sizeof(BroadcastHello) == 20, "hello must stay 20 bytes");
+
+struct BroadcastWelcome {
+    char magic[8];
+    uint32_t version;
+    uint32_t width; // rendition size
+    uint32_t height;
+};
+static_assert(sizeof(BroadcastWelcome) == 20, "welcome must stay 20 bytes");
+
+struct BroadcastFrameHeader {
+    uint32_t sequence;
+    uint32_t size;
+    uint32_t flags;
+    uint32_t reserved;
+};
+static_assert(sizeof(BroadcastFrameHeader) == 16, "frame header must stay 16 bytes");
+
+struct BroadcastAck {
+    uint32_t sequence;
+    uint32_t flags;
+};
+static_assert(sizeof(BroadcastAck) == 8, "ack must stay 8 bytes");
+
+// -l: "unix:/path", "tcp:PORT" (localhost), "tcp:HOST:PORT", or a bare socket path
+void run_broadcast_server(const std::map<std::string, std::string> &params);
+void run_broadcast_client(const std::map<std::string, std::string> &params);
+
+#endif /* broadcast_hpp */
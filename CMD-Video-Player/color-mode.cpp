@@ -0,0 +1,122 @@
+//
+//  color-mode.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "color-mode.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+// The quantizer lookup cube has 2^5 entries per channel
+#define CUBE_BITS 5
+
+static const uint8_t XTERM_CUBE_LEVELS[6] = {0, 95, 135, 175, 215, 255};
+
+static int nearest_cube_level(int value) {
+    int best = 0;
+    for (int i = 1; i < 6; ++i) {
+        if (std::abs(XTERM_CUBE_LEVELS[i] - value) < std::abs(XTERM_CUBE_LEVELS[best] - value))
+            best = i;
+    }
+    return best;
+}
+
+static uint8_t nearest_palette_color(int r, int g, int b) {
+    int cr = nearest_cube_level(r), cg = nearest_cube_level(g), cb = nearest_cube_level(b);
+    int dr = XTERM_CUBE_LEVELS[cr] - r, dg = XTERM_CUBE_LEVELS[cg] - g, db = XTERM_CUBE_LEVELS[cb] - b;
+    int cube_distance = dr * dr + dg * dg + db * db;
+
+    // 灰阶 232-255: 8, 18, ..., 238
+    int gray_index = std::clamp(((r + g + b) / 3 - 3) / 10, 0, 23);
+    int gray = 8 + gray_index * 10;
+    int gray_distance = (gray - r) * (gray - r) + (gray - g) * (gray - g) + (gray - b) * (gray - b);
+
+    if (gray_distance < cube_distance)
+        return static_cast<uint8_t>(232 + gray_index);
+    return static_cast<uint8_t>(16 + cr * 36 + cg * 6 + cb);
+}
+
+uint8_t quantize_256(uint8_t r, uint8_t g, uint8_t b) {
+    static const std::array<uint8_t, 1 << (3 * CUBE_BITS)> cube = [] {
+        std::array<uint8_t, 1 << (3 * CUBE_BITS)> table{};
+        const int shift = 8 - CUBE_BITS, center = 1 << (shift - 1);
+        for (int i = 0; i < (1 << CUBE_BITS); ++i)
+            for (int j = 0; j < (1 << CUBE_BITS); ++j)
+                for (int k = 0; k < (1 << CUBE_BITS); ++k)
+                    table[(i << (2 * CUBE_BITS)) | (j << CUBE_BITS) | k] =
+                        nearest_palette_color((i << shift) | center, (j << shift) | center, (k << shift) | center);
+        return table;
+    }();
+    const int shift = 8 - CUBE_BITS;
+    return cube[((r >> shift) << (2 * CUBE_BITS)) | ((g >> shift) << CUBE_BITS) | (b >> shift)];
+}
+
+static inline uint32_t encode_color(const uint8_t *rgb, ColorDepth depth) {
+    if (depth == COLOR_DEPTH_256)
+        return COLOR_PALETTE_FLAG | quantize_256(rgb[0], rgb[1], rgb[2]);
+    return (rgb[0] << 16) | (rgb[1] << 8) | rgb[2];
+}
+
+ColorSampler::~ColorSampler() {
+    sws_freeContext(sws_ctx);
+}
+
+bool ColorSampler::sample(const AVFrame *frame, int width, int height) {
+    // The scaler is only rebuilt when the source or the terminal size changes
+    sws_ctx = sws_getCachedContext(sws_ctx, frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+                                   width, height, AV_PIX_FMT_RGB24, SWS_AREA, NULL, NULL, NULL);
+    if (!sws_ctx)
+        return false;
+    rgb_stride = width * 3;
+    rgb.resize(static_cast<size_t>(rgb_stride) * height);
+    uint8_t *dst[1] = {rgb.data()};
+    int dst_stride[1] = {rgb_stride};
+    return sws_scale(sws_ctx, frame->data, frame->linesize, 0, frame->height, dst, dst_stride) == height;
+}
+
+bool ColorSampler::colorize(const AVFrame *frame, ColorMode mode, int left, int top, int width, int height, GlyphGrid &grid) {
+    if (mode.depth == COLOR_DEPTH_NONE || width <= 0 || height <= 0 || !grid.colored())
+        return false;
+
+    if (!mode.half_block) {
+        if (!sample(frame, width, height))
+            return false;
+        for (int y = 0; y < height; ++y) {
+            const uint8_t *src = rgb.data() + static_cast<size_t>(y) * rgb_stride;
+            uint32_t *fg = grid.fg_row(top + y) + left;
+            for (int x = 0; x < width; ++x) {
+                fg[x] = encode_color(src + x * 3, mode.depth);
+            }
+        }
+        return true;
+    }
+
+    // 每个格子上下两个像素：上半块用前景色，下半块用背景色
+    if (!sample(frame, width, height * 2))
+        return false;
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *upper = rgb.data() + static_cast<size_t>(y * 2) * rgb_stride;
+        const uint8_t *lower = upper + rgb_stride;
+        char *cells = grid.row(top + y) + left;
+        uint32_t *fg = grid.fg_row(top + y) + left;
+        uint32_t *bg = grid.bg_row(top + y) + left;
+        for (int x = 0; x < width; ++x) {
+            uint32_t upper_color = encode_color(upper + x * 3, mode.depth);
+            uint32_t lower_color = encode_color(lower + x * 3, mode.depth);
+            // Both halves alike: a plain space in the background color is shorter to send
+            cells[x] = upper_color == lower_color ? ' ' : GLYPH_UPPER_HALF;
+            fg[x] = upper_color;
+            bg[x] = lower_color;
+        }
+    }
+    return true;
+}
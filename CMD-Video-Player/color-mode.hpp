@@ -0,0 +1,55 @@
+//
+//  color-mode.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef color_mode_hpp
+#define color_mode_hpp
+
+#include <cstdint>
+#include <vector>
+
+#include "terminal-renderer.hpp"
+
+struct AVFrame;
+struct SwsContext;
+
+enum ColorDepth {
+    COLOR_DEPTH_NONE, // monochrome glyphs
+    COLOR_DEPTH_256,  // xterm 256-color palette
+    COLOR_DEPTH_TRUE, // 24-bit SGR
+};
+
+struct ColorMode {
+    ColorDepth depth = COLOR_DEPTH_NONE;
+    // Every cell becomes an upper half block showing two pixels instead of a glyph
+    bool half_block = false;
+};
+
+// Nearest color of the xterm palette (cube and gray ramp, indices 16-255)
+uint8_t quantize_256(uint8_t r, uint8_t g, uint8_t b);
+
+// Scales decoded frames to RGB at terminal resolution and paints the cell colors.
+// Holds a scaler, so each conversion worker needs its own.
+class ColorSampler {
+public:
+    ColorSampler() = default;
+    ColorSampler(const ColorSampler &) = delete;
+    ColorSampler &operator=(const ColorSampler &) = delete;
+    ~ColorSampler();
+
+    // Colors the width x height cells at (left, top) of grid from frame.
+    // Glyph mode only sets the foreground, half-block mode also fills in the cells.
+    bool colorize(const AVFrame *frame, ColorMode mode, int left, int top, int width, int height, GlyphGrid &grid);
+
+private:
+    bool sample(const AVFrame *frame, int width, int height);
+
+    SwsContext *sws_ctx = nullptr;
+    std::vector<uint8_t> rgb; // RGB24, rows of rgb_stride bytes
+    int rgb_stride = 0;
+};
+
+#endif /* color_mode_hpp */
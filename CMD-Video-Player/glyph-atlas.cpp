@@ -0,0 +1,320 @@
+//
+//  glyph-atlas.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "glyph-atlas.hpp"
+#include "ascii-kernel.hpp"
+#include "thread-pool.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define SHAPE_MATCH_X86 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define SHAPE_MATCH_NEON 1
+#include <arm_neon.h>
+#endif
+
+// A cell whose darkest and brightest pixel are closer than this has no edge worth a shape
+#define EDGE_MIN_CONTRAST 48
+// Cell rows per band on the conversion pool
+#define MIN_BAND_CELL_ROWS 4
+
+struct GlyphShape {
+    uint16_t code;
+    const char *rows[SHAPE_CELL_HEIGHT]; // '#' marks ink
+};
+
+// Hand-drawn 4x8 coverage of the ASCII glyphs that carry a direction or an outline
+static const GlyphShape ASCII_SHAPES[] = {
+    {' ', {"....", "....", "....", "....", "....", "....", "....", "...."}},
+    {'.', {"....", "....", "....", "....", "....", "....", "....", ".##."}},
+    {',', {"....", "....", "....", "....", "....", "....", ".##.", ".#.."}},
+    {'\'', {".##.", ".##.", "....", "....", "....", "....", "....", "...."}},
+    {'`', {".#..", "..#.", "....", "....", "....", "....", "....", "...."}},
+    {'"', {"#..#", "#..#", "....", "....", "....", "....", "....", "...."}},
+    {'^', {".##.", "#..#", "....", "....", "....", "....", "....", "...."}},
+    {'-', {"....", "....", "....", "####", "....", "....", "....", "...."}},
+    {'_', {"....", "....", "....", "....", "....", "....", "....", "####"}},
+    {'=', {"....", "....", "####", "....", "....", "####", "....", "...."}},
+    {':', {"....", "....", ".##.", "....", "....", ".##.", "....", "...."}},
+    {';', {"....", "....", ".##.", "....", "....", ".##.", ".#..", "...."}},
+    {'|', {".##.", ".##.", ".##.", ".##.", ".##.", ".##.", ".##.", ".##."}},
+    {'/', {"...#", "...#", "..#.", "..#.", ".#..", ".#..", "#...", "#..."}},
+    {'\\', {"#...", "#...", ".#..", ".#..", "..#.", "..#.", "...#", "...#"}},
+    {'(', {"..#.", ".#..", "#...", "#...", "#...", "#...", ".#..", "..#."}},
+    {')', {".#..", "..#.", "...#", "...#", "...#", "...#", "..#.", ".#.."}},
+    {'[', {"###.", "#...", "#...", "#...", "#...", "#...", "#...", "###."}},
+    {']', {".###", "...#", "...#", "...#", "...#", "...#", "...#", ".###"}},
+    {'<', {"....", "...#", "..#.", ".#..", "#...", ".#..", "..#.", "...#"}},
+    {'>', {"....", "#...", ".#..", "..#.", "...#", "..#.", ".#..", "#..."}},
+    {'+', {"....", "....", ".##.", "####", "####", ".##.", "....", "...."}},
+    {'x', {"....", "....", "#..#", ".##.", ".##.", "#..#", "....", "...."}},
+    {'o', {"....", "....", "....", ".##.", "#..#", "#..#", ".##.", "...."}},
+    {'L', {"#...", "#...", "#...", "#...", "#...", "#...", "#...", "####"}},
+    {'T', {"####", ".##.", ".##.", ".##.", ".##.", ".##.", ".##.", ".##."}},
+    {'#', {"....", "#..#", "####", "#..#", "#..#", "####", "#..#", "...."}},
+    {'@', {".##.", "#..#", "#.##", "#.##", "#.##", "#...", "#..#", ".##."}},
+};
+
+// Block elements, exact on the 4x8 grid (▁ is left out, it has the same coverage as _)
+static const GlyphShape BLOCK_SHAPES[] = {
+    {0x2588, {"####", "####", "####", "####", "####", "####", "####", "####"}}, // █
+    {0x2580, {"####", "####", "####", "####", "....", "....", "....", "...."}}, // ▀
+    {0x2584, {"....", "....", "....", "....", "####", "####", "####", "####"}}, // ▄
+    {0x258C, {"##..", "##..", "##..", "##..", "##..", "##..", "##..", "##.."}}, // ▌
+    {0x2590, {"..##", "..##", "..##", "..##", "..##", "..##", "..##", "..##"}}, // ▐
+    {0x2598, {"##..", "##..", "##..", "##..", "....", "....", "....", "...."}}, // ▘
+    {0x259D, {"..##", "..##", "..##", "..##", "....", "....", "....", "...."}}, // ▝
+    {0x2596, {"....", "....", "....", "....", "##..", "##..", "##..", "##.."}}, // ▖
+    {0x2597, {"....", "....", "....", "....", "..##", "..##", "..##", "..##"}}, // ▗
+    {0x259A, {"##..", "##..", "##..", "##..", "..##", "..##", "..##", "..##"}}, // ▚
+    {0x259E, {"..##", "..##", "..##", "..##", "##..", "##..", "##..", "##.."}}, // ▞
+    {0x2599, {"##..", "##..", "##..", "##..", "####", "####", "####", "####"}}, // ▙
+    {0x259B, {"####", "####", "####", "####", "##..", "##..", "##..", "##.."}}, // ▛
+    {0x259C, {"####", "####", "####", "####", "..##", "..##", "..##", "..##"}}, // ▜
+    {0x259F, {"..##", "..##", "..##", "..##", "####", "####", "####", "####"}}, // ▟
+    {0x2594, {"####", "....", "....", "....", "....", "....", "....", "...."}}, // ▔
+    {0x2582, {"....", "....", "....", "....", "....", "....", "####", "####"}}, // ▂
+    {0x2583, {"....", "....", "....", "....", "....", "####", "####", "####"}}, // ▃
+    {0x2585, {"....", "....", "....", "####", "####", "####", "####", "####"}}, // ▅
+    {0x2586, {"....", "....", "####", "####", "####", "####", "####", "####"}}, // ▆
+    {0x2587, {"....", "####", "####", "####", "####", "####", "####", "####"}}, // ▇
+    {0x258E, {"#...", "#...", "#...", "#...", "#...", "#...", "#...", "#..."}}, // ▎
+    {0x2595, {"...#", "...#", "...#", "...#", "...#", "...#", "...#", "...#"}}, // ▕
+};
+
+// 4x4 Bayer matrix, thresholds spread over 0-255
+static const uint8_t BAYER_4X4[4][4] = {
+    {8, 136, 40, 168},
+    {200, 72, 232, 104},
+    {56, 184, 24, 152},
+    {248, 120, 216, 88}};
+
+static uint32_t shape_mask(const GlyphShape &shape) {
+    uint32_t mask = 0;
+    for (int y = 0; y < SHAPE_CELL_HEIGHT; ++y)
+        for (int x = 0; x < SHAPE_CELL_WIDTH; ++x)
+            if (shape.rows[y][x] == '#')
+                mask |= 1u << (y * SHAPE_CELL_WIDTH + x);
+    return mask;
+}
+
+const GlyphAtlas &glyph_atlas() {
+    static const GlyphAtlas atlas = [] {
+        GlyphAtlas built;
+        for (const GlyphShape &shape : ASCII_SHAPES) {
+            built.masks.push_back(shape_mask(shape));
+            built.codes.push_back(shape.code);
+        }
+        built.ascii_count = built.masks.size();
+        for (const GlyphShape &shape : BLOCK_SHAPES) {
+            built.masks.push_back(shape_mask(shape));
+            built.codes.push_back(shape.code);
+        }
+        return built;
+    }();
+    return atlas;
+}
+
+// Entries after begin only replace best when strictly closer, so ties keep the earlier entry
+static void match_scalar(const uint32_t *masks, size_t begin, size_t count, uint32_t mask, size_t &best, int &best_distance) {
+    for (size_t i = begin; i < count; ++i) {
+        int distance = std::popcount(masks[i] ^ mask);
+        if (distance < best_distance) {
+            best_distance = distance;
+            best = i;
+        }
+    }
+}
+
+// Hamming distance (the SAD of two bitmaps) to four entries at a time; ties go to the earlier entry
+#ifdef SHAPE_MATCH_X86
+static inline __m128i popcount_epi32(__m128i v) {
+    // 16 位移位跨字节带过来的位都被掩码去掉了
+    v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi16(v, 1), _mm_set1_epi8(0x55)));
+    v = _mm_add_epi8(_mm_and_si128(v, _mm_set1_epi8(0x33)), _mm_and_si128(_mm_srli_epi16(v, 2), _mm_set1_epi8(0x33)));
+    v = _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi16(v, 4)), _mm_set1_epi8(0x0F));
+    v = _mm_add_epi32(v, _mm_srli_epi32(v, 8));
+    v = _mm_add_epi32(v, _mm_srli_epi32(v, 16));
+    return _mm_and_si128(v, _mm_set1_epi32(0x3F));
+}
+
+size_t match_glyph_shape(const GlyphAtlas &atlas, size_t count, uint32_t mask) {
+    const uint32_t *masks = atlas.masks.data();
+    const __m128i target = _mm_set1_epi32(static_cast<int>(mask));
+    __m128i best_distance = _mm_set1_epi32(64), best_index = _mm_setzero_si128();
+    __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i candidates = _mm_loadu_si128(reinterpret_cast<const __m128i *>(masks + i));
+        __m128i distance = popcount_epi32(_mm_xor_si128(candidates, target));
+        __m128i better = _mm_cmplt_epi32(distance, best_distance);
+        best_distance = _mm_or_si128(_mm_and_si128(better, distance), _mm_andnot_si128(better, best_distance));
+        best_index = _mm_or_si128(_mm_and_si128(better, index), _mm_andnot_si128(better, best_index));
+        index = _mm_add_epi32(index, _mm_set1_epi32(4));
+    }
+    alignas(16) int distances[4], indices[4];
+    _mm_store_si128(reinterpret_cast<__m128i *>(distances), best_distance);
+    _mm_store_si128(reinterpret_cast<__m128i *>(indices), best_index);
+    int distance = 64;
+    size_t best = 0;
+    for (int lane = 0; lane < 4; ++lane) {
+        if (distances[lane] < distance || (distances[lane] == distance && static_cast<size_t>(indices[lane]) < best)) {
+            distance = distances[lane];
+            best = indices[lane];
+        }
+    }
+    match_scalar(masks, i, count, mask, best, distance);
+    return best;
+}
+#elif defined(SHAPE_MATCH_NEON)
+size_t match_glyph_shape(const GlyphAtlas &atlas, size_t count, uint32_t mask) {
+    const uint32_t *masks = atlas.masks.data();
+    const uint32x4_t target = vdupq_n_u32(mask);
+    uint32x4_t best_distance = vdupq_n_u32(64), best_index = vdupq_n_u32(0);
+    uint32x4_t index = {0, 1, 2, 3};
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint32x4_t candidates = vld1q_u32(masks + i);
+        uint8x16_t bits = vcntq_u8(vreinterpretq_u8_u32(veorq_u32(candidates, target)));
+        uint32x4_t distance = vpaddlq_u16(vpaddlq_u8(bits));
+        uint32x4_t better = vcltq_u32(distance, best_distance);
+        best_distance = vbslq_u32(better, distance, best_distance);
+        best_index = vbslq_u32(better, index, best_index);
+        index = vaddq_u32(index, vdupq_n_u32(4));
+    }
+    uint32_t distances[4], indices[4];
+    vst1q_u32(distances, best_distance);
+    vst1q_u32(indices, best_index);
+    int distance = 64;
+    size_t best = 0;
+    for (int lane = 0; lane < 4; ++lane) {
+        if (static_cast<int>(distances[lane]) < distance || (static_cast<int>(distances[lane]) == distance && indices[lane] < best)) {
+            distance = distances[lane];
+            best = indices[lane];
+        }
+    }
+    match_scalar(masks, i, count, mask, best, distance);
+    return best;
+}
+#else
+size_t match_glyph_shape(const GlyphAtlas &atlas, size_t count, uint32_t mask) {
+    size_t best = 0;
+    int distance = 64;
+    match_scalar(atlas.masks.data(), 0, count, mask, best, distance);
+    return best;
+}
+#endif
+
+static inline void put_glyph(GlyphGrid &grid, char *cell, size_t offset, uint16_t code) {
+    if (code < 0x80) {
+        *cell = static_cast<char>(code);
+    } else {
+        *cell = GLYPH_WIDE;
+        grid.wide[offset] = code;
+    }
+}
+
+void image_to_glyph_shapes(const cv::Mat &image, GlyphGrid &grid, int left, int top, const char *ascii_chars, bool dither) {
+    const GlyphAtlas &atlas = glyph_atlas();
+    const size_t candidates = grid.has_wide() ? atlas.masks.size() : atlas.ascii_count;
+    const int cell_cols = image.cols / SHAPE_CELL_WIDTH, cell_rows = image.rows / SHAPE_CELL_HEIGHT;
+    band_pool().parallel_for(cell_rows, MIN_BAND_CELL_ROWS, [&](int begin, int end) {
+        // The tone table is per thread, so every band looks it up on its own thread
+        const GlyphLUT &lut = get_glyph_lut(ascii_chars);
+        uint8_t pixels[SHAPE_CELL_WIDTH * SHAPE_CELL_HEIGHT];
+        for (int cy = begin; cy < end; ++cy) {
+            char *cells = grid.row(top + cy) + left;
+            size_t offset = static_cast<size_t>(top + cy) * grid.width + left;
+            for (int cx = 0; cx < cell_cols; ++cx) {
+                int lo = 255, hi = 0, sum = 0;
+                for (int y = 0; y < SHAPE_CELL_HEIGHT; ++y) {
+                    const uchar *src = image.ptr<uchar>(cy * SHAPE_CELL_HEIGHT + y) + cx * SHAPE_CELL_WIDTH;
+                    for (int x = 0; x < SHAPE_CELL_WIDTH; ++x) {
+                        uint8_t value = src[x];
+                        pixels[y * SHAPE_CELL_WIDTH + x] = value;
+                        lo = std::min<int>(lo, value);
+                        hi = std::max<int>(hi, value);
+                        sum += value;
+                    }
+                }
+                if (!dither && hi - lo < EDGE_MIN_CONTRAST) {
+                    cells[cx] = lut.glyphs[sum / (SHAPE_CELL_WIDTH * SHAPE_CELL_HEIGHT)];
+                    continue;
+                }
+                // 暗像素即墨迹，与字符集里 0 -> '@' 的方向一致
+                uint32_t mask = 0;
+                int mid = (lo + hi) / 2;
+                for (int i = 0; i < SHAPE_CELL_WIDTH * SHAPE_CELL_HEIGHT; ++i) {
+                    int threshold = dither ? BAYER_4X4[(cy * SHAPE_CELL_HEIGHT + i / SHAPE_CELL_WIDTH) & 3][i & 3] : mid;
+                    if (pixels[i] < threshold)
+                        mask |= 1u << i;
+                }
+                put_glyph(grid, cells + cx, offset + cx, atlas.codes[match_glyph_shape(atlas, candidates, mask)]);
+            }
+        }
+    });
+}
+
+// Each dot of the 2x4 block stands for a 2x2 square of the 4x8 atlas grid
+static uint32_t braille_to_shape_mask(uint8_t dots) {
+    static const int DOT_X[8] = {0, 0, 0, 1, 1, 1, 0, 1};
+    static const int DOT_Y[8] = {0, 1, 2, 0, 1, 2, 3, 3};
+    uint32_t mask = 0;
+    for (int dot = 0; dot < 8; ++dot) {
+        if (!(dots & (1 << dot)))
+            continue;
+        int x = DOT_X[dot] * 2, y = DOT_Y[dot] * 2;
+        mask |= 3u << (y * SHAPE_CELL_WIDTH + x);
+        mask |= 3u << ((y + 1) * SHAPE_CELL_WIDTH + x);
+    }
+    return mask;
+}
+
+void image_to_braille(const cv::Mat &image, GlyphGrid &grid, int left, int top, const char * /*ascii_chars*/, bool dither) {
+    // Dot numbering of U+2800: 1-3 down the left column, 4-6 down the right, 7 and 8 on the bottom row
+    static const uint8_t DOT_BITS[BRAILLE_CELL_HEIGHT][BRAILLE_CELL_WIDTH] = {{0x01, 0x08}, {0x02, 0x10}, {0x04, 0x20}, {0x40, 0x80}};
+    const GlyphAtlas &atlas = glyph_atlas();
+    const bool wide = grid.has_wide();
+    const int cell_cols = image.cols / BRAILLE_CELL_WIDTH, cell_rows = image.rows / BRAILLE_CELL_HEIGHT;
+    band_pool().parallel_for(cell_rows, MIN_BAND_CELL_ROWS, [&](int begin, int end) {
+        for (int cy = begin; cy < end; ++cy) {
+            char *cells = grid.row(top + cy) + left;
+            size_t offset = static_cast<size_t>(top + cy) * grid.width + left;
+            for (int cx = 0; cx < cell_cols; ++cx) {
+                uint8_t pixels[BRAILLE_CELL_HEIGHT][BRAILLE_CELL_WIDTH];
+                int lo = 255, hi = 0;
+                for (int y = 0; y < BRAILLE_CELL_HEIGHT; ++y) {
+                    const uchar *src = image.ptr<uchar>(cy * BRAILLE_CELL_HEIGHT + y) + cx * BRAILLE_CELL_WIDTH;
+                    for (int x = 0; x < BRAILLE_CELL_WIDTH; ++x) {
+                        pixels[y][x] = src[x];
+                        lo = std::min<int>(lo, src[x]);
+                        hi = std::max<int>(hi, src[x]);
+                    }
+                }
+                // A flat cell is judged against mid gray, otherwise it would turn into noise
+                int mid = hi - lo < EDGE_MIN_CONTRAST ? 128 : (lo + hi) / 2;
+                uint8_t dots = 0;
+                for (int y = 0; y < BRAILLE_CELL_HEIGHT; ++y) {
+                    for (int x = 0; x < BRAILLE_CELL_WIDTH; ++x) {
+                        int threshold = dither ? BAYER_4X4[(cy * BRAILLE_CELL_HEIGHT + y) & 3][(cx * BRAILLE_CELL_WIDTH + x) & 3] : mid;
+                        if (pixels[y][x] < threshold)
+                            dots |= DOT_BITS[y][x];
+                    }
+                }
+                if (!dots)
+                    cells[cx] = ' ';
+                else if (wide)
+                    put_glyph(grid, cells + cx, offset + cx, static_cast<uint16_t>(0x2800 + dots));
+                else
+                    cells[cx] = static_cast<char>(atlas.codes[match_glyph_shape(atlas, atlas.ascii_count, braille_to_shape_mask(dots))]);
+            }
+        }
+    });
+}
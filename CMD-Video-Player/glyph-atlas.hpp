@@ -0,0 +1,48 @@
+//
+//  glyph-atlas.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef glyph_atlas_hpp
+#define glyph_atlas_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "terminal-renderer.hpp"
+
+// Luma pixels sampled per cell by the shape renderer (one coverage bit each) and by the Braille renderer (one dot each)
+#define SHAPE_CELL_WIDTH 4
+#define SHAPE_CELL_HEIGHT 8
+#define BRAILLE_CELL_WIDTH 2
+#define BRAILLE_CELL_HEIGHT 4
+
+// Coverage bitmaps of the glyphs the shape renderer chooses from, 4x8 bits each (bit = y * 4 + x,
+// set where the glyph puts ink). ASCII glyphs come first, so a grid without wide glyphs can stop there.
+struct GlyphAtlas {
+    std::vector<uint32_t> masks;
+    std::vector<uint16_t> codes; // ASCII byte or Unicode code point
+    size_t ascii_count = 0;
+};
+
+// Built on first use and shared by all threads
+const GlyphAtlas &glyph_atlas();
+
+// Index of the atlas entry among the first count ones with the fewest bits differing from mask
+size_t match_glyph_shape(const GlyphAtlas &atlas, size_t count, uint32_t mask);
+
+// -ct ed: every cell is binarized around its own mid tone and matched against the atlas, so edges
+// keep their direction. Flat cells fall back to the tone of ascii_chars. image holds
+// SHAPE_CELL_WIDTH x SHAPE_CELL_HEIGHT pixels per cell. dither replaces the per-cell threshold with
+// an ordered (Bayer) one.
+void image_to_glyph_shapes(const cv::Mat &image, GlyphGrid &grid, int left, int top, const char *ascii_chars, bool dither);
+// -ct br: one Braille dot per pixel of a BRAILLE_CELL_WIDTH x BRAILLE_CELL_HEIGHT block.
+// Without wide glyphs in grid it falls back to the ASCII part of the shape renderer.
+void image_to_braille(const cv::Mat &image, GlyphGrid &grid, int left, int top, const char *ascii_chars, bool dither);
+
+#endif /* glyph_atlas_hpp */
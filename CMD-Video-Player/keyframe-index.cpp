@@ -0,0 +1,123 @@
+//
+//  keyframe-index.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "keyframe-index.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#define KEYFRAME_INDEX_MAGIC "CVPKEYS1"
+
+// Identifies the exact file an index was built from
+struct KeyframeIndexHeader {
+    char magic[8];
+    uint64_t file_size;
+    int64_t modified_time;
+    int32_t stream_index;
+    uint32_t reserved;
+    uint64_t count;
+};
+
+static bool read_file_stamp(const std::string &video_path, uint64_t &file_size, int64_t &modified_time) {
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(video_path, ec))
+        return false;
+    file_size = std::filesystem::file_size(video_path, ec);
+    if (ec)
+        return false;
+    auto modified = std::filesystem::last_write_time(video_path, ec);
+    if (ec)
+        return false;
+    modified_time = modified.time_since_epoch().count();
+    return true;
+}
+
+bool KeyframeIndex::load(const std::string &video_path, int stream_index) {
+    KeyframeIndexHeader header;
+    uint64_t file_size;
+    int64_t modified_time;
+    if (!read_file_stamp(video_path, file_size, modified_time))
+        return false;
+
+    std::ifstream input(video_path + KEYFRAME_INDEX_EXTENSION, std::ios::binary);
+    if (!input.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        memcmp(header.magic, KEYFRAME_INDEX_MAGIC, sizeof(header.magic)) != 0 ||
+        header.file_size != file_size || header.modified_time != modified_time || header.stream_index != stream_index)
+        return false;
+
+    std::vector<int64_t> loaded(header.count);
+    if (!input.read(reinterpret_cast<char *>(loaded.data()), loaded.size() * sizeof(int64_t)))
+        return false;
+    this->stream_index = stream_index;
+    keyframes.swap(loaded);
+    return true;
+}
+
+bool KeyframeIndex::save(const std::string &video_path) const {
+    KeyframeIndexHeader header = {};
+    if (!read_file_stamp(video_path, header.file_size, header.modified_time))
+        return false;
+    memcpy(header.magic, KEYFRAME_INDEX_MAGIC, sizeof(header.magic));
+    header.stream_index = stream_index;
+    header.count = keyframes.size();
+
+    // 视频所在目录不可写时就不保存，下次再扫描
+    std::ofstream output(video_path + KEYFRAME_INDEX_EXTENSION, std::ios::binary | std::ios::trunc);
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    output.write(reinterpret_cast<const char *>(keyframes.data()), keyframes.size() * sizeof(int64_t));
+    return static_cast<bool>(output);
+}
+
+bool KeyframeIndex::scan(const std::string &video_path, int stream_index, const std::atomic<bool> &abort) {
+    AVFormatContext *format_ctx = nullptr;
+    if (avformat_open_input(&format_ctx, video_path.c_str(), NULL, NULL) < 0)
+        return false;
+    if (stream_index < 0 || stream_index >= static_cast<int>(format_ctx->nb_streams)) {
+        avformat_close_input(&format_ctx);
+        return false;
+    }
+    // The demuxer does not even hand out the other streams' packets
+    for (unsigned i = 0; i < format_ctx->nb_streams; ++i) {
+        if (static_cast<int>(i) != stream_index)
+            format_ctx->streams[i]->discard = AVDISCARD_ALL;
+    }
+
+    std::vector<int64_t> found;
+    AVPacket *packet = av_packet_alloc();
+    while (!abort && av_read_frame(format_ctx, packet) >= 0) {
+        if (packet->stream_index == stream_index && (packet->flags & AV_PKT_FLAG_KEY)) {
+            int64_t timestamp = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+            if (timestamp != AV_NOPTS_VALUE)
+                found.push_back(timestamp);
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    avformat_close_input(&format_ctx);
+    if (abort)
+        return false;
+
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    this->stream_index = stream_index;
+    keyframes.swap(found);
+    return true;
+}
+
+bool KeyframeIndex::find_before(int64_t timestamp, int64_t &keyframe) const {
+    auto next = std::upper_bound(keyframes.begin(), keyframes.end(), timestamp);
+    if (next == keyframes.begin())
+        return false;
+    keyframe = *(next - 1);
+    return true;
+}
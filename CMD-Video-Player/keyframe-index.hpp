@@ -0,0 +1,38 @@
+//
+//  keyframe-index.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef keyframe_index_hpp
+#define keyframe_index_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define KEYFRAME_INDEX_EXTENSION ".keyframes"
+
+// Timestamps of the keyframes of one video stream, so that a seek can land exactly on the
+// last keyframe before its target. Persisted next to the video as <video>.keyframes and
+// only trusted while the video keeps its size and modification time.
+class KeyframeIndex {
+public:
+    bool load(const std::string &video_path, int stream_index);
+    bool save(const std::string &video_path) const;
+
+    // Reads every packet of the stream without decoding anything, stops early when abort is set
+    bool scan(const std::string &video_path, int stream_index, const std::atomic<bool> &abort);
+
+    // Latest keyframe at or before timestamp (stream time base), false when none is known
+    bool find_before(int64_t timestamp, int64_t &keyframe) const;
+    size_t size() const { return keyframes.size(); }
+
+private:
+    int stream_index = -1;
+    std::vector<int64_t> keyframes; // sorted, in the stream's time base
+};
+
+#endif /* keyframe_index_hpp */
@@ -0,0 +1,42 @@
+//
+//  luma-scaler.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "luma-scaler.hpp"
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+LumaScaler::~LumaScaler() {
+    sws_freeContext(sws_ctx);
+}
+
+bool LumaScaler::scale(const AVFrame *frame, int width, int height, cv::Mat &luma) {
+    if (width <= 0 || height <= 0 || frame->format < 0)
+        return false;
+
+    if (!sws_ctx || frame->width != source_width || frame->height != source_height || frame->format != source_format ||
+        width != target_width || height != target_height) {
+        // 只有终端尺寸或视频格式变化时才重建
+        sws_freeContext(sws_ctx);
+        sws_ctx = sws_getContext(frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+                                 width, height, AV_PIX_FMT_GRAY8, SWS_AREA, NULL, NULL, NULL);
+        if (!sws_ctx)
+            return false;
+        source_width = frame->width;
+        source_height = frame->height;
+        source_format = frame->format;
+        target_width = width;
+        target_height = height;
+    }
+
+    luma.create(height, width, CV_8UC1);
+    uint8_t *dst[1] = {luma.data};
+    int dst_stride[1] = {static_cast<int>(luma.step)};
+    return sws_scale(sws_ctx, frame->data, frame->linesize, 0, frame->height, dst, dst_stride) == height;
+}
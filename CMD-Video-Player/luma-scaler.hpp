@@ -0,0 +1,36 @@
+//
+//  luma-scaler.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef luma_scaler_hpp
+#define luma_scaler_hpp
+
+#include <opencv2/opencv.hpp>
+
+struct AVFrame;
+struct SwsContext;
+
+// Area-averaging downscaler from a decoded frame straight to the terminal-sized luma image.
+// Handles every pixel format the decoder can produce (10-bit, packed, RGB...), not only 8-bit planar Y.
+// Holds a scaler, so each conversion worker needs its own.
+class LumaScaler {
+public:
+    LumaScaler() = default;
+    LumaScaler(const LumaScaler &) = delete;
+    LumaScaler &operator=(const LumaScaler &) = delete;
+    ~LumaScaler();
+
+    // Writes a width x height CV_8UC1 image into luma, reusing its buffer when the size is unchanged
+    bool scale(const AVFrame *frame, int width, int height, cv::Mat &luma);
+
+private:
+    SwsContext *sws_ctx = nullptr;
+    // What sws_ctx was built for, it is only rebuilt when one of these changes
+    int source_width = 0, source_height = 0, source_format = -1;
+    int target_width = 0, target_height = 0;
+};
+
+#endif /* luma_scaler_hpp */
@@ -5,12 +5,24 @@
 //  Created by Robert He on 2024/9/1.
 //
 
+#include "ascii-cache.hpp"
 #include "basic-functions.hpp"
+#include "benchmark.hpp"
+#include "broadcast.hpp"
 #include "video-player.hpp"
 
 const char *SELF_FILE_NAME;
 std::map<std::string, std::string> default_options;
 
+// Fills in the saved defaults of the given options that the command did not set itself
+void apply_default_options(std::map<std::string, std::string> &options, const std::map<std::string, std::string> &defaults,
+                           std::initializer_list<const char *> keys) {
+    for (const char *key : keys) {
+        if (!params_include(options, key) && params_include(defaults, key))
+            options[key] = defaults.at(key);
+    }
+}
+
 void get_command(std::string input = "$DEFAULT") {
     if (input == "$DEFAULT") {
         std::cout << std::endl
@@ -61,20 +73,41 @@ void get_command(std::string input = "$DEFAULT") {
         return;
     }
     
+    if (cmdOpts.arguments[0] == "bench") {
+        apply_default_options(cmdOpts.options, default_options, {"-v", "-ct", "-dt", "-c", "-chars", "-j", "-cm", "-mm", "-ib"});
+        run_benchmark(cmdOpts.options);
+        get_command();
+        return;
+    }
+
+    if (cmdOpts.arguments[0] == "export") {
+        apply_default_options(cmdOpts.options, default_options, {"-v", "-ct", "-dt", "-c", "-chars", "-j", "-mm", "-ib"});
+
+        export_ascii_cache(cmdOpts.options);
+        get_command();
+        return;
+    }
+
+    if (cmdOpts.arguments[0] == "serve") {
+        apply_default_options(cmdOpts.options, default_options, {"-v", "-ct", "-dt", "-c", "-chars", "-j", "-cm", "-mm", "-ib"});
+        run_broadcast_server(cmdOpts.options);
+        get_command();
+        return;
+    }
+
+    if (cmdOpts.arguments[0] == "watch") {
+        // No defaults here: the server picked the conversion options, and a saved -size
+        // would stop the client from following its own terminal
+        run_broadcast_client(cmdOpts.options);
+        show_interface();
+        get_command();
+        return;
+    }
+
     if (cmdOpts.arguments[0] == "play") {
         // 如果用户没有提供某些选项，使用默认设置
-        if (!params_include(cmdOpts.options, "-v") && params_include(default_options, "-v")) {
-            cmdOpts.options["-v"] = default_options["-v"];
-        }
-        if (!params_include(cmdOpts.options, "-ct") && params_include(default_options, "-ct")) {
-            cmdOpts.options["-ct"] = default_options["-ct"];
-        }
-        if (!params_include(cmdOpts.options, "-c") && params_include(default_options, "-c")) {
-            cmdOpts.options["-c"] = default_options["-c"];
-        }
-        if (!params_include(cmdOpts.options, "-chars") && params_include(default_options, "-chars")) {
-            cmdOpts.options["-chars"] = default_options["-chars"];
-        }
+        apply_default_options(cmdOpts.options, default_options,
+                              {"-v", "-ct", "-dt", "-c", "-chars", "-j", "-cm", "-mm", "-aq", "-ib", "-ad", "-hud"});
         
         play_video(cmdOpts.options);
         show_interface();
@@ -109,11 +142,24 @@ int main(int argc, const char *argv[]) {
         case 1:
             start_ui();
             break;
-        case 2:
-            play_video(parseArguments(std::make_pair(argc, argv), SELF_FILE_NAME).options);
-            break;
-        default:
-            start_ui();
+        default: {
+            // CMD-Video-Player video.mp4, or play options like -v - when fed through a pipe
+            cmdOptions cmdOpts = parseArguments(std::make_pair(argc, argv), SELF_FILE_NAME);
+            if (cmdOpts.arguments.size() == 1 && cmdOpts.arguments[0] == "serve") {
+                run_broadcast_server(cmdOpts.options);
+                break;
+            }
+            if (cmdOpts.arguments.size() == 1 && cmdOpts.arguments[0] == "watch") {
+                run_broadcast_client(cmdOpts.options);
+                break;
+            }
+            if (!params_include(cmdOpts.options, "-v") && cmdOpts.arguments.size() == 1)
+                cmdOpts.options["-v"] = cmdOpts.arguments[0];
+            if (params_include(cmdOpts.options, "-v"))
+                play_video(cmdOpts.options);
+            else
+                start_ui();
+        }
     }
     return 0;
 }
@@ -0,0 +1,118 @@
+//
+//  playback-clock.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "playback-clock.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+// The audio position only drives the clock while the callback keeps consuming data
+#define AUDIO_CLOCK_STALE_NS 250000000LL
+
+// Sequence counter writes: odd while the fields are being updated
+static uint32_t begin_write(std::atomic<uint32_t> &seq) {
+    uint32_t s = seq.load(std::memory_order_relaxed);
+    seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return s + 2;
+}
+
+static void end_write(std::atomic<uint32_t> &seq, uint32_t next) {
+    seq.store(next, std::memory_order_release);
+}
+
+template <typename ReadFields>
+static void read_consistent(const std::atomic<uint32_t> &seq, ReadFields read_fields) {
+    uint32_t before, after;
+    do {
+        before = seq.load(std::memory_order_acquire);
+        read_fields();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = seq.load(std::memory_order_relaxed);
+    } while (before != after || (before & 1));
+}
+
+int64_t PlaybackClock::steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void PlaybackClock::set_audio_format(int bytes_per_second, size_t device_buffer_bytes) {
+    this->bytes_per_second = bytes_per_second;
+    this->device_buffer_bytes = device_buffer_bytes;
+}
+
+void PlaybackClock::anchor_audio(uint64_t byte_pos, double pts) {
+    uint32_t next = begin_write(anchor_seq);
+    anchor_pos.store(byte_pos, std::memory_order_relaxed);
+    anchor_pts.store(pts, std::memory_order_relaxed);
+    anchored.store(true, std::memory_order_relaxed);
+    end_write(anchor_seq, next);
+}
+
+void PlaybackClock::audio_consumed(uint64_t byte_pos) {
+    uint32_t next = begin_write(consumed_seq);
+    consumed_pos.store(byte_pos, std::memory_order_relaxed);
+    consumed_ns.store(steady_ns(), std::memory_order_relaxed);
+    end_write(consumed_seq, next);
+}
+
+void PlaybackClock::set_external(double pts) {
+    uint32_t next = begin_write(external_seq);
+    external_pts.store(pts, std::memory_order_relaxed);
+    external_ns.store(steady_ns(), std::memory_order_relaxed);
+    end_write(external_seq, next);
+}
+
+bool PlaybackClock::read_audio(double &pts) const {
+    int bps = bytes_per_second.load(std::memory_order_relaxed);
+    if (bps <= 0)
+        return false;
+
+    uint64_t a_pos = 0, c_pos = 0;
+    double a_pts = 0;
+    bool a_valid = false;
+    int64_t c_ns = 0;
+    read_consistent(anchor_seq, [&] {
+        a_pos = anchor_pos.load(std::memory_order_relaxed);
+        a_pts = anchor_pts.load(std::memory_order_relaxed);
+        a_valid = anchored.load(std::memory_order_relaxed);
+    });
+    read_consistent(consumed_seq, [&] {
+        c_pos = consumed_pos.load(std::memory_order_relaxed);
+        c_ns = consumed_ns.load(std::memory_order_relaxed);
+    });
+
+    int64_t elapsed_ns = steady_ns() - c_ns;
+    // 还没播到锚点之后的数据（刚跳转）或者回调已经停止取数据
+    if (!a_valid || c_pos < a_pos || elapsed_ns > AUDIO_CLOCK_STALE_NS)
+        return false;
+
+    // What was handed to the device during the last callback is still playing
+    double buffer_seconds = static_cast<double>(device_buffer_bytes.load(std::memory_order_relaxed)) / bps;
+    double played_at_callback = a_pts + (static_cast<double>(c_pos - a_pos) / bps) - buffer_seconds;
+    pts = played_at_callback + std::min(elapsed_ns / 1e9, buffer_seconds);
+    return true;
+}
+
+double PlaybackClock::now() const {
+    double pts;
+    if (read_audio(pts))
+        return pts;
+
+    double e_pts = 0;
+    int64_t e_ns = 0;
+    read_consistent(external_seq, [&] {
+        e_pts = external_pts.load(std::memory_order_relaxed);
+        e_ns = external_ns.load(std::memory_order_relaxed);
+    });
+    return e_pts + (steady_ns() - e_ns) / 1e9;
+}
+
+bool PlaybackClock::audio_driven() const {
+    double pts;
+    return read_audio(pts);
+}
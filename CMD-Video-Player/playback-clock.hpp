@@ -0,0 +1,57 @@
+//
+//  playback-clock.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef playback_clock_hpp
+#define playback_clock_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Master clock of a playback, in seconds of media time.
+// While audio is playing it follows the samples the audio callback has actually consumed,
+// otherwise (no audio, audio ended, right after a seek) it runs on the steady clock.
+class PlaybackClock {
+public:
+    // bytes_per_second of the device format, device_buffer_bytes is what one callback hands to SDL
+    void set_audio_format(int bytes_per_second, size_t device_buffer_bytes);
+
+    // Decoder: the audio byte at stream position byte_pos has timestamp pts
+    void anchor_audio(uint64_t byte_pos, double pts);
+    // Audio callback: everything before byte_pos has been handed to the device
+    void audio_consumed(uint64_t byte_pos);
+
+    // Restarts the steady clock at pts
+    void set_external(double pts);
+
+    double now() const;
+    // True when now() currently comes from the audio position
+    bool audio_driven() const;
+
+private:
+    static int64_t steady_ns();
+    bool read_audio(double &pts) const;
+
+    std::atomic<int> bytes_per_second{0};
+    std::atomic<uint64_t> device_buffer_bytes{0};
+
+    // Written by one thread each, read under a sequence counter
+    std::atomic<uint32_t> anchor_seq{0};
+    std::atomic<uint64_t> anchor_pos{0};
+    std::atomic<double> anchor_pts{0};
+    std::atomic<bool> anchored{false};
+
+    std::atomic<uint32_t> consumed_seq{0};
+    std::atomic<uint64_t> consumed_pos{0};
+    std::atomic<int64_t> consumed_ns{0};
+
+    std::atomic<uint32_t> external_seq{0};
+    std::atomic<double> external_pts{0};
+    std::atomic<int64_t> external_ns{0};
+};
+
+#endif /* playback_clock_hpp */
@@ -0,0 +1,30 @@
+//
+//  playback-stats.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "playback-stats.hpp"
+
+PlaybackStatsWindow PlaybackStats::take_window(int64_t now_ns) {
+    PlaybackStatsWindow window;
+    for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+        int64_t ns = stages[stage].ns.exchange(0, std::memory_order_relaxed);
+        uint64_t frames = stages[stage].frames.exchange(0, std::memory_order_relaxed);
+        window.stage_ms[stage] = frames ? ns / 1e6 / frames : 0;
+    }
+    uint64_t shown_frames = shown.exchange(0, std::memory_order_relaxed);
+    int64_t drift = drift_ns.exchange(0, std::memory_order_relaxed);
+    if (shown_frames)
+        window.drift_ms = drift / 1e6 / shown_frames;
+    uint64_t written_frames = written.exchange(0, std::memory_order_relaxed);
+    uint64_t bytes = bytes_written.exchange(0, std::memory_order_relaxed);
+    if (written_frames)
+        window.bytes_per_frame = static_cast<double>(bytes) / written_frames;
+    // 第一次调用只开始计时
+    if (window_start_ns && now_ns > window_start_ns)
+        window.fps = written_frames * 1e9 / (now_ns - window_start_ns);
+    window_start_ns = now_ns;
+    return window;
+}
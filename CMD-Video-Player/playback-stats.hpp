@@ -0,0 +1,67 @@
+//
+//  playback-stats.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef playback_stats_hpp
+#define playback_stats_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+enum PlaybackStage {
+    STAGE_DECODE,  // video decoder
+    STAGE_SCALE,   // luma scaling
+    STAGE_CONVERT, // glyphs and colors
+    STAGE_WRITE,   // diff rendering and the write to the terminal
+    STAGE_COUNT,
+};
+
+// Averages over one HUD refresh window
+struct PlaybackStatsWindow {
+    double fps = 0; // frames written to the terminal per second
+    double stage_ms[STAGE_COUNT] = {};
+    double bytes_per_frame = 0;
+    double drift_ms = 0; // shown frames behind (+) or ahead of (-) the master clock
+};
+
+// Counters every pipeline thread bumps per frame with relaxed atomic adds, cheap enough to
+// stay on while the HUD is hidden. Only the thread scheduling the frames reads them, once per HUD refresh.
+class PlaybackStats {
+public:
+    // frames is how many frames the time was spent on, 0 for work that did not finish one
+    void add_stage_time(PlaybackStage stage, int64_t ns, uint64_t frames = 1) {
+        stages[stage].ns.fetch_add(ns, std::memory_order_relaxed);
+        stages[stage].frames.fetch_add(frames, std::memory_order_relaxed);
+    }
+    // Frame handed to the terminal writer drift_seconds after its pts
+    void frame_shown(double drift_seconds) {
+        shown.fetch_add(1, std::memory_order_relaxed);
+        drift_ns.fetch_add(static_cast<int64_t>(drift_seconds * 1e9), std::memory_order_relaxed);
+    }
+    // Frame that actually reached the terminal
+    void frame_written(size_t bytes) {
+        written.fetch_add(1, std::memory_order_relaxed);
+        bytes_written.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    // Averages since the previous call and restarts the window
+    PlaybackStatsWindow take_window(int64_t now_ns);
+
+private:
+    struct StageCounter {
+        std::atomic<int64_t> ns{0};
+        std::atomic<uint64_t> frames{0};
+    };
+    StageCounter stages[STAGE_COUNT];
+    std::atomic<uint64_t> shown{0};
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> bytes_written{0};
+    std::atomic<int64_t> drift_ns{0};
+    int64_t window_start_ns = 0;
+};
+
+#endif /* playback_stats_hpp */
@@ -0,0 +1,260 @@
+//
+//  playlist.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "playlist.hpp"
+#include "ascii-cache.hpp"
+#include "basic-functions.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <set>
+
+// Files picked up from a directory or a pattern, exported ASCII clips included
+static const std::set<std::string> PLAYLIST_EXTENSIONS = {
+    ".3gp", ".avi", ".cva", ".flv", ".gif", ".m2ts", ".m4v", ".mkv", ".mov",
+    ".mp4", ".mpeg", ".mpg", ".mts", ".ogv", ".ts", ".webm", ".wmv"};
+
+static std::string lowercase(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+    return text;
+}
+
+static bool has_wildcard(const std::string &text) {
+    return text.find_first_of("*?[") != std::string::npos;
+}
+
+static bool is_m3u_file(const std::filesystem::path &path) {
+    std::string extension = lowercase(path.extension().string());
+    return extension == ".m3u" || extension == ".m3u8";
+}
+
+// Shell-style matching of a single file name: * any run, ? one character, [abc] / [a-z] / [!a] a set
+static bool wildcard_match(const char *pattern, const char *name) {
+    const char *star = nullptr, *star_name = nullptr;
+    while (*name) {
+        if (*pattern == '*') {
+            star = pattern++;
+            star_name = name;
+            continue;
+        }
+        bool matched = false;
+        const char *next = pattern + 1;
+        if (*pattern == '?') {
+            matched = true;
+        } else if (*pattern == '[') {
+            const char *p = pattern + 1;
+            bool negate = *p == '!' || *p == '^';
+            if (negate)
+                p++;
+            bool in_set = false;
+            for (bool first = true; *p && (first || *p != ']'); first = false, ++p) {
+                if (p[1] == '-' && p[2] && p[2] != ']') {
+                    in_set |= *p <= *name && *name <= p[2];
+                    p += 2;
+                } else {
+                    in_set |= *p == *name;
+                }
+            }
+            if (*p == ']') {
+                matched = in_set != negate;
+                next = p + 1;
+            } else {
+                matched = *pattern == *name; // 没有闭合的 [ 按普通字符处理
+            }
+        } else {
+            matched = *pattern && *pattern == *name;
+        }
+        if (matched) {
+            pattern = next;
+            name++;
+        } else if (star) {
+            pattern = star + 1;
+            name = ++star_name;
+        } else {
+            return false;
+        }
+    }
+    while (*pattern == '*')
+        pattern++;
+    return *pattern == '\0';
+}
+
+bool is_playlist_source(const std::string &source) {
+    std::error_code ec;
+    if (std::filesystem::is_directory(source, ec))
+        return true;
+    if (std::filesystem::is_regular_file(source, ec))
+        return is_m3u_file(source);
+    return has_wildcard(std::filesystem::path(source).filename().string());
+}
+
+static void collect_directory(const std::filesystem::path &directory, const std::string &pattern, std::vector<std::string> &items) {
+    std::error_code ec;
+    std::vector<std::string> found;
+    for (const auto &entry : std::filesystem::directory_iterator(directory, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.empty() || name[0] == '.' || !entry.is_regular_file(ec))
+            continue;
+        if (!PLAYLIST_EXTENSIONS.count(lowercase(entry.path().extension().string())))
+            continue;
+        if (!pattern.empty() && !wildcard_match(pattern.c_str(), name.c_str()))
+            continue;
+        found.push_back(entry.path().string());
+    }
+    std::sort(found.begin(), found.end());
+    items.insert(items.end(), found.begin(), found.end());
+}
+
+static void collect_m3u(const std::filesystem::path &playlist_path, std::vector<std::string> &items) {
+    std::ifstream playlist(playlist_path);
+    std::string line;
+    bool first_line = true;
+    while (std::getline(playlist, line)) {
+        if (first_line && line.compare(0, 3, "\xEF\xBB\xBF") == 0)
+            line.erase(0, 3); // m3u8 files may start with a BOM
+        first_line = false;
+        size_t begin = line.find_first_not_of(" \t\r");
+        size_t end = line.find_last_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#')
+            continue;
+        std::string entry = line.substr(begin, end - begin + 1);
+        // URLs and absolute paths are taken as they are, the rest is relative to the m3u file
+        std::filesystem::path entry_path(entry);
+        if (entry.find("://") == std::string::npos && entry_path.is_relative())
+            entry = (playlist_path.parent_path() / entry_path).string();
+        items.push_back(entry);
+    }
+}
+
+std::vector<std::string> collect_playlist_items(const std::string &source) {
+    std::vector<std::string> items;
+    std::filesystem::path source_path(source);
+    std::error_code ec;
+    if (std::filesystem::is_directory(source_path, ec)) {
+        collect_directory(source_path, "", items);
+    } else if (std::filesystem::is_regular_file(source_path, ec)) {
+        if (is_m3u_file(source_path))
+            collect_m3u(source_path, items);
+        else
+            items.push_back(source);
+    } else if (has_wildcard(source_path.filename().string())) {
+        // Only the file name may hold wildcards
+        std::filesystem::path directory = source_path.parent_path();
+        collect_directory(directory.empty() ? std::filesystem::path(".") : directory, source_path.filename().string(), items);
+    }
+    return items;
+}
+
+PlaylistPrefetcher::~PlaylistPrefetcher() {
+    if (worker.joinable())
+        worker.join();
+    close_media_input(prepared);
+}
+
+void PlaylistPrefetcher::start(const std::string &path, int term_width, int term_height, const MediaInputOptions &options) {
+    if (worker.joinable())
+        worker.join();
+    close_media_input(prepared);
+    prepare_error.clear();
+    opened = false;
+    worker = std::thread([this, path, term_width, term_height, options] {
+        opened = open_media_input(path, term_width, term_height, prepared, prepare_error, options);
+        if (opened)
+            prefetch_media_input(prepared);
+    });
+}
+
+bool PlaylistPrefetcher::take(MediaInput &input, std::string &error) {
+    if (worker.joinable())
+        worker.join();
+    if (!opened) {
+        error = prepare_error;
+        return false;
+    }
+    input = std::move(prepared);
+    prepared = MediaInput();
+    opened = false;
+    return true;
+}
+
+void play_playlist(const std::map<std::string, std::string> &params) {
+    std::string source = params.at("-v");
+    std::vector<std::string> items = collect_playlist_items(source);
+    if (items.empty()) {
+        print_error("Error: No videos found for the playlist", source);
+        return;
+    }
+    bool loop = params_include(params, "-loop");
+
+    // Initialize FFmpeg
+    avformat_network_init();
+
+    // The terminal size is taken when an item is prepared, -fd keeps full decoding quality
+    MediaInputOptions input_options = select_input_options(params);
+    auto prefetch_item = [&](PlaylistPrefetcher &prefetcher, const std::string &path) {
+        int decodeTermWidth = 0, decodeTermHeight = 0;
+        if (!params_include(params, "-fd"))
+            get_terminal_size(decodeTermWidth, decodeTermHeight);
+        prefetcher.start(path, decodeTermWidth, decodeTermHeight, input_options);
+    };
+
+    AudioOutput audio;
+    PlaylistPrefetcher prefetcher;
+    std::vector<std::string> failed;
+    bool quit = false;
+    size_t played_in_pass = 0;
+    if (!is_ascii_cache_file(items[0]))
+        prefetch_item(prefetcher, items[0]);
+
+    for (size_t index = 0; !quit; ++index) {
+        if (index == items.size()) {
+            // 一轮下来一个都放不了就别再循环了
+            if (!loop || played_in_pass == 0)
+                break;
+            index = 0;
+            played_in_pass = 0;
+            failed.clear();
+        }
+        const std::string &path = items[index];
+        size_t next = index + 1 < items.size() ? index + 1 : (loop ? 0 : items.size());
+
+        if (is_ascii_cache_file(path)) {
+            // Exported clips need no decoder, the next video is prepared while this one streams
+            if (next < items.size() && !is_ascii_cache_file(items[next]))
+                prefetch_item(prefetcher, items[next]);
+            if (stream_ascii_cache(path, quit))
+                played_in_pass++;
+            continue;
+        }
+
+        MediaInput input;
+        std::string error;
+        bool opened = prefetcher.take(input, error);
+        if (next < items.size() && !is_ascii_cache_file(items[next]))
+            prefetch_item(prefetcher, items[next]);
+        if (!opened) {
+            failed.push_back(error + ": " + path);
+            continue;
+        }
+        quit = play_media_input(input, params, audio);
+        close_media_input(input);
+        played_in_pass++;
+    }
+
+    close_audio_output(audio);
+
+    if (!quit) {
+        std::cout << "Playlist completed! Press any key to continue...";
+        for (const std::string &message : failed)
+            std::cerr << std::endl << message;
+        getchar();
+        clear_screen();
+    } else {
+        clear_screen();
+        std::cout << "Playback interrupted!\n";
+    }
+}
@@ -0,0 +1,46 @@
+//
+//  playlist.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef playlist_hpp
+#define playlist_hpp
+
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "video-player.hpp"
+
+// A directory, a file name pattern with * ? or [...], or an .m3u/.m3u8 file
+bool is_playlist_source(const std::string &source);
+// The videos of a playlist source in playing order. Directories and patterns yield the files
+// with a known video extension sorted by name, m3u files their entries as listed.
+std::vector<std::string> collect_playlist_items(const std::string &source);
+
+// Opens, probes and pre-decodes the next item while the current one is playing
+class PlaylistPrefetcher {
+public:
+    PlaylistPrefetcher() = default;
+    PlaylistPrefetcher(const PlaylistPrefetcher &) = delete;
+    PlaylistPrefetcher &operator=(const PlaylistPrefetcher &) = delete;
+    ~PlaylistPrefetcher();
+
+    void start(const std::string &path, int term_width, int term_height, const MediaInputOptions &options);
+    // Waits for the item started last. Returns false, with error set, when it could not be opened.
+    bool take(MediaInput &input, std::string &error);
+
+private:
+    std::thread worker;
+    MediaInput prepared;
+    std::string prepare_error;
+    bool opened = false;
+};
+
+// play -v with a playlist source: plays the items back to back on one audio device, -loop repeats them
+void play_playlist(const std::map<std::string, std::string> &params);
+
+#endif /* playlist_hpp */
@@ -0,0 +1,252 @@
+//
+//  probe-cache.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "probe-cache.hpp"
+#include "basic-functions.hpp"
+
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+}
+
+#define PROBE_CACHE_MAGIC "CVPPROBE"
+#define PROBE_CACHE_VERSION 1
+#define PROBE_CACHE_MAX_STREAMS 256
+#define PROBE_CACHE_MAX_EXTRADATA (1 << 20)
+
+struct ProbeCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t stream_count;
+    uint64_t file_size;
+    int64_t modified_time;
+    int64_t duration;
+    int64_t start_time;
+    int64_t bit_rate;
+    uint32_t path_length; // followed by the path, then the streams
+    uint32_t reserved;
+};
+
+// The parts of AVStream/AVCodecParameters that probing fills in, followed by extradata_size bytes
+struct ProbeStreamRecord {
+    int32_t codec_type, codec_id;
+    uint32_t codec_tag;
+    int32_t format;
+    int64_t bit_rate;
+    int32_t bits_per_coded_sample, bits_per_raw_sample, profile, level;
+    int32_t width, height, sar_num, sar_den, framerate_num, framerate_den;
+    int32_t field_order, color_range, color_primaries, color_trc, color_space, chroma_location, video_delay;
+    int32_t channel_order, channels;
+    uint64_t channel_mask;
+    int32_t sample_rate, block_align, frame_size, initial_padding, trailing_padding, seek_preroll;
+    int32_t avg_frame_rate_num, avg_frame_rate_den, r_frame_rate_num, r_frame_rate_den;
+    int64_t start_time, duration;
+    int32_t extradata_size, reserved;
+};
+
+static std::filesystem::path probe_cache_file(const std::string &video_path) {
+    std::error_code ec;
+    std::string absolute = std::filesystem::absolute(video_path, ec).string();
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.probe", static_cast<unsigned long long>(std::hash<std::string>()(absolute)));
+    return std::filesystem::path(get_config_file_path()).parent_path() / "probe-cache" / name;
+}
+
+static bool read_file_stamp(const std::string &video_path, uint64_t &file_size, int64_t &modified_time) {
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(video_path, ec))
+        return false;
+    file_size = std::filesystem::file_size(video_path, ec);
+    if (ec)
+        return false;
+    auto modified = std::filesystem::last_write_time(video_path, ec);
+    modified_time = modified.time_since_epoch().count();
+    return !ec;
+}
+
+static ProbeStreamRecord record_stream(const AVStream *stream) {
+    const AVCodecParameters *par = stream->codecpar;
+    ProbeStreamRecord r = {};
+    r.codec_type = par->codec_type;
+    r.codec_id = par->codec_id;
+    r.codec_tag = par->codec_tag;
+    r.format = par->format;
+    r.bit_rate = par->bit_rate;
+    r.bits_per_coded_sample = par->bits_per_coded_sample;
+    r.bits_per_raw_sample = par->bits_per_raw_sample;
+    r.profile = par->profile;
+    r.level = par->level;
+    r.width = par->width;
+    r.height = par->height;
+    r.sar_num = par->sample_aspect_ratio.num;
+    r.sar_den = par->sample_aspect_ratio.den;
+    r.framerate_num = par->framerate.num;
+    r.framerate_den = par->framerate.den;
+    r.field_order = par->field_order;
+    r.color_range = par->color_range;
+    r.color_primaries = par->color_primaries;
+    r.color_trc = par->color_trc;
+    r.color_space = par->color_space;
+    r.chroma_location = par->chroma_location;
+    r.video_delay = par->video_delay;
+    // 自定义声道映射不缓存，只记声道数
+    r.channel_order = par->ch_layout.order == AV_CHANNEL_ORDER_NATIVE ? AV_CHANNEL_ORDER_NATIVE : AV_CHANNEL_ORDER_UNSPEC;
+    r.channels = par->ch_layout.nb_channels;
+    r.channel_mask = par->ch_layout.order == AV_CHANNEL_ORDER_NATIVE ? par->ch_layout.u.mask : 0;
+    r.sample_rate = par->sample_rate;
+    r.block_align = par->block_align;
+    r.frame_size = par->frame_size;
+    r.initial_padding = par->initial_padding;
+    r.trailing_padding = par->trailing_padding;
+    r.seek_preroll = par->seek_preroll;
+    r.avg_frame_rate_num = stream->avg_frame_rate.num;
+    r.avg_frame_rate_den = stream->avg_frame_rate.den;
+    r.r_frame_rate_num = stream->r_frame_rate.num;
+    r.r_frame_rate_den = stream->r_frame_rate.den;
+    r.start_time = stream->start_time;
+    r.duration = stream->duration;
+    r.extradata_size = par->extradata ? par->extradata_size : 0;
+    return r;
+}
+
+static void restore_stream(AVStream *stream, const ProbeStreamRecord &r, const std::vector<uint8_t> &extradata) {
+    AVCodecParameters *par = stream->codecpar;
+    par->codec_tag = r.codec_tag;
+    par->format = r.format;
+    par->bit_rate = r.bit_rate;
+    par->bits_per_coded_sample = r.bits_per_coded_sample;
+    par->bits_per_raw_sample = r.bits_per_raw_sample;
+    par->profile = r.profile;
+    par->level = r.level;
+    par->width = r.width;
+    par->height = r.height;
+    par->sample_aspect_ratio = AVRational{r.sar_num, r.sar_den};
+    par->framerate = AVRational{r.framerate_num, r.framerate_den};
+    par->field_order = static_cast<decltype(par->field_order)>(r.field_order);
+    par->color_range = static_cast<decltype(par->color_range)>(r.color_range);
+    par->color_primaries = static_cast<decltype(par->color_primaries)>(r.color_primaries);
+    par->color_trc = static_cast<decltype(par->color_trc)>(r.color_trc);
+    par->color_space = static_cast<decltype(par->color_space)>(r.color_space);
+    par->chroma_location = static_cast<decltype(par->chroma_location)>(r.chroma_location);
+    par->video_delay = r.video_delay;
+    av_channel_layout_uninit(&par->ch_layout);
+    if (r.channel_order == AV_CHANNEL_ORDER_NATIVE) {
+        av_channel_layout_from_mask(&par->ch_layout, r.channel_mask);
+    } else {
+        par->ch_layout.order = AV_CHANNEL_ORDER_UNSPEC;
+        par->ch_layout.nb_channels = r.channels;
+    }
+    par->sample_rate = r.sample_rate;
+    par->block_align = r.block_align;
+    par->frame_size = r.frame_size;
+    par->initial_padding = r.initial_padding;
+    par->trailing_padding = r.trailing_padding;
+    par->seek_preroll = r.seek_preroll;
+    // Extradata the demuxer read from the header is kept, the cached copy only fills a gap
+    if (!par->extradata && !extradata.empty()) {
+        par->extradata = static_cast<uint8_t *>(av_mallocz(extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE));
+        if (par->extradata) {
+            memcpy(par->extradata, extradata.data(), extradata.size());
+            par->extradata_size = static_cast<int>(extradata.size());
+        }
+    }
+    stream->avg_frame_rate = AVRational{r.avg_frame_rate_num, r.avg_frame_rate_den};
+    stream->r_frame_rate = AVRational{r.r_frame_rate_num, r.r_frame_rate_den};
+    if (stream->start_time == AV_NOPTS_VALUE)
+        stream->start_time = r.start_time;
+    if (stream->duration == AV_NOPTS_VALUE)
+        stream->duration = r.duration;
+}
+
+bool apply_probe_cache(const std::string &video_path, AVFormatContext *format_ctx) {
+    uint64_t file_size;
+    int64_t modified_time;
+    if (!read_file_stamp(video_path, file_size, modified_time))
+        return false;
+
+    std::ifstream input(probe_cache_file(video_path), std::ios::binary);
+    ProbeCacheHeader header;
+    if (!input.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        memcmp(header.magic, PROBE_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != PROBE_CACHE_VERSION ||
+        header.file_size != file_size || header.modified_time != modified_time ||
+        header.stream_count != format_ctx->nb_streams || header.stream_count > PROBE_CACHE_MAX_STREAMS ||
+        header.path_length > 4096)
+        return false;
+    std::string cached_path(header.path_length, '\0');
+    std::error_code ec;
+    if (!input.read(cached_path.data(), cached_path.size()) || cached_path != std::filesystem::absolute(video_path, ec).string())
+        return false;
+
+    // Everything is read and checked before the first stream is touched
+    std::vector<ProbeStreamRecord> records(header.stream_count);
+    std::vector<std::vector<uint8_t>> extradata(header.stream_count);
+    for (uint32_t i = 0; i < header.stream_count; ++i) {
+        ProbeStreamRecord &r = records[i];
+        if (!input.read(reinterpret_cast<char *>(&r), sizeof(r)) ||
+            r.extradata_size < 0 || r.extradata_size > PROBE_CACHE_MAX_EXTRADATA)
+            return false;
+        extradata[i].resize(r.extradata_size);
+        if (!input.read(reinterpret_cast<char *>(extradata[i].data()), r.extradata_size))
+            return false;
+        // 容器里的流和缓存对不上（比如文件被替换但时间戳没变）就老老实实重新探测
+        const AVCodecParameters *par = format_ctx->streams[i]->codecpar;
+        if (par->codec_type != r.codec_type || (par->codec_id != AV_CODEC_ID_NONE && par->codec_id != r.codec_id))
+            return false;
+    }
+
+    for (uint32_t i = 0; i < header.stream_count; ++i) {
+        format_ctx->streams[i]->codecpar->codec_id = static_cast<AVCodecID>(records[i].codec_id);
+        restore_stream(format_ctx->streams[i], records[i], extradata[i]);
+    }
+    if (format_ctx->duration == AV_NOPTS_VALUE)
+        format_ctx->duration = header.duration;
+    if (format_ctx->start_time == AV_NOPTS_VALUE)
+        format_ctx->start_time = header.start_time;
+    if (format_ctx->bit_rate <= 0)
+        format_ctx->bit_rate = header.bit_rate;
+    return true;
+}
+
+void save_probe_cache(const std::string &video_path, const AVFormatContext *format_ctx) {
+    ProbeCacheHeader header = {};
+    if (format_ctx->nb_streams > PROBE_CACHE_MAX_STREAMS ||
+        !read_file_stamp(video_path, header.file_size, header.modified_time))
+        return;
+    std::error_code ec;
+    std::string absolute = std::filesystem::absolute(video_path, ec).string();
+    std::filesystem::path cache_file = probe_cache_file(video_path);
+    std::filesystem::create_directories(cache_file.parent_path(), ec);
+    if (ec)
+        return;
+
+    memcpy(header.magic, PROBE_CACHE_MAGIC, sizeof(header.magic));
+    header.version = PROBE_CACHE_VERSION;
+    header.stream_count = format_ctx->nb_streams;
+    header.duration = format_ctx->duration;
+    header.start_time = format_ctx->start_time;
+    header.bit_rate = format_ctx->bit_rate;
+    header.path_length = static_cast<uint32_t>(absolute.size());
+
+    std::ofstream output(cache_file, std::ios::binary | std::ios::trunc);
+    output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    output.write(absolute.data(), absolute.size());
+    for (unsigned i = 0; i < format_ctx->nb_streams; ++i) {
+        const AVStream *stream = format_ctx->streams[i];
+        ProbeStreamRecord r = record_stream(stream);
+        if (r.extradata_size > PROBE_CACHE_MAX_EXTRADATA)
+            r.extradata_size = 0;
+        output.write(reinterpret_cast<const char *>(&r), sizeof(r));
+        output.write(reinterpret_cast<const char *>(stream->codecpar->extradata), r.extradata_size);
+    }
+    if (!output) {
+        output.close();
+        std::filesystem::remove(cache_file, ec); // 写了一半的缓存下次会被当成有效的
+    }
+}
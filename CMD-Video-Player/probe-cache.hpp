@@ -0,0 +1,26 @@
+//
+//  probe-cache.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef probe_cache_hpp
+#define probe_cache_hpp
+
+#include <string>
+
+struct AVFormatContext;
+
+// Results of avformat_find_stream_info (codec parameters, durations, frame rates) kept under
+// ~/.config/CMD-Video-Player/probe-cache/, one file per video, valid while the video keeps
+// its path, size and modification time, so a repeated open skips the probing.
+
+// Fills format_ctx in as avformat_find_stream_info would have. Returns false and leaves
+// format_ctx alone when there is no valid entry or the container no longer matches it.
+bool apply_probe_cache(const std::string &video_path, AVFormatContext *format_ctx);
+
+// Stores what avformat_find_stream_info found for the next open of video_path
+void save_probe_cache(const std::string &video_path, const AVFormatContext *format_ctx);
+
+#endif /* probe_cache_hpp */
@@ -0,0 +1,103 @@
+//
+//  quality-controller.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "quality-controller.hpp"
+
+#include <algorithm>
+
+#define QUALITY_WINDOW_NS 500000000LL // 0.5 s per decision
+// Share of the wall time the busiest stage may use before a step down, and below which a step up is tried
+#define QUALITY_OVERLOAD_LOAD 0.85
+#define QUALITY_HEADROOM_LOAD 0.45
+// Calm windows before a step up, doubled each time the step up is taken back within RESTORE_PROBATION_NS
+#define QUALITY_RESTORE_WINDOWS 4
+#define QUALITY_MAX_RESTORE_WINDOWS 32
+#define RESTORE_PROBATION_NS 3000000000LL
+
+void QualityController::configure(bool enabled, size_t convert_workers, bool expensive_conversion, bool colored) {
+    active = enabled;
+    workers = std::max<size_t>(convert_workers, 1);
+    has_expensive_conversion = expensive_conversion;
+    has_color = colored;
+    current = QUALITY_FULL;
+    restore_after_windows = QUALITY_RESTORE_WINDOWS;
+}
+
+bool QualityController::applies(int level) const {
+    if (level == QUALITY_STATIC)
+        return has_expensive_conversion;
+    if (level == QUALITY_NO_COLOR)
+        return has_color;
+    return level >= QUALITY_FULL && level < QUALITY_LEVEL_COUNT;
+}
+
+void QualityController::step(int direction) {
+    int next = level() + direction;
+    while (next > QUALITY_FULL && next < QUALITY_LEVEL_COUNT && !applies(next))
+        next += direction;
+    if (applies(next))
+        current = static_cast<QualityLevel>(next);
+}
+
+void QualityController::update(int64_t now_ns) {
+    if (!active)
+        return;
+    if (window_start_ns == 0) {
+        window_start_ns = now_ns;
+        convert_busy_ns = output_busy_ns = 0;
+        drops = 0;
+        return;
+    }
+    int64_t window_ns = now_ns - window_start_ns;
+    if (window_ns < QUALITY_WINDOW_NS)
+        return;
+
+    // The workers share the conversion, the writer is on its own
+    double convert_load = static_cast<double>(convert_busy_ns.exchange(0)) / (static_cast<double>(window_ns) * workers);
+    double output_load = static_cast<double>(output_busy_ns.exchange(0)) / static_cast<double>(window_ns);
+    double load = std::max(convert_load, output_load);
+    uint64_t dropped = drops.exchange(0);
+    window_start_ns = now_ns;
+
+    if (load > QUALITY_OVERLOAD_LOAD || dropped > 1) {
+        calm_windows = 0;
+        if (last_restore_ns && now_ns - last_restore_ns < RESTORE_PROBATION_NS)
+            restore_after_windows = std::min(restore_after_windows * 2, QUALITY_MAX_RESTORE_WINDOWS);
+        last_restore_ns = 0;
+        step(1);
+    } else if (load < QUALITY_HEADROOM_LOAD && !dropped && level() != QUALITY_FULL) {
+        if (++calm_windows >= restore_after_windows) {
+            calm_windows = 0;
+            last_restore_ns = now_ns;
+            step(-1);
+        }
+    } else {
+        calm_windows = 0;
+    }
+}
+
+int QualityController::resolution_percent() const {
+    QualityLevel l = level();
+    return l >= QUALITY_RES_50 ? 50 : l >= QUALITY_RES_75 ? 75 : 100;
+}
+
+std::string QualityController::describe() const {
+    if (!active)
+        return "";
+    if (level() == QUALITY_FULL)
+        return "[q full] ";
+    std::string text = "[q";
+    if (level() >= QUALITY_SKIP_FRAMES)
+        text += " skip";
+    if (resolution_percent() < 100)
+        text += " " + std::to_string(resolution_percent()) + "%";
+    if (static_conversion())
+        text += " st";
+    if (color_disabled())
+        text += " mono";
+    return text + "] ";
+}
@@ -0,0 +1,75 @@
+//
+//  quality-controller.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef quality_controller_hpp
+#define quality_controller_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Steps the controller walks through, each one keeps those before it
+enum QualityLevel {
+    QUALITY_FULL,
+    QUALITY_SKIP_FRAMES, // every other frame is not converted
+    QUALITY_RES_75,      // the picture covers 3/4 of the terminal in each direction
+    QUALITY_RES_50,      // half of it
+    QUALITY_STATIC,      // dy, ed and br fall back to the plain static conversion
+    QUALITY_NO_COLOR,    // monochrome glyphs
+    QUALITY_LEVEL_COUNT,
+};
+
+// -ad: keeps a playback on its frame-time budget on slow machines or terminals.
+// Convert workers and the terminal writer report how long they were busy, once per window
+// the busier of both is compared with the wall time and the quality goes one step down
+// when it is about to fall behind, or one step up after a while with enough headroom.
+// Steps that change nothing for the chosen options are left out.
+class QualityController {
+public:
+    void configure(bool enabled, size_t convert_workers, bool expensive_conversion, bool colored);
+    bool enabled() const { return active; }
+
+    // Any thread
+    void add_convert_time(int64_t ns) { convert_busy_ns += ns; }
+    void add_output_time(int64_t ns) { output_busy_ns += ns; }
+    void frame_dropped() { drops++; }
+
+    // Frame scheduling thread, once per shown frame
+    void update(int64_t now_ns);
+
+    QualityLevel level() const { return current.load(std::memory_order_relaxed); }
+    // frame_number counts the frames of one convert worker
+    bool skip_conversion(uint64_t frame_number) const { return level() >= QUALITY_SKIP_FRAMES && (frame_number & 1); }
+    int resolution_percent() const;
+    bool static_conversion() const { return level() >= QUALITY_STATIC; }
+    bool color_disabled() const { return level() >= QUALITY_NO_COLOR; }
+    // "[q full] ", "[q skip 75% st mono] " and so on, empty when disabled
+    std::string describe() const;
+
+private:
+    bool applies(int level) const;
+    void step(int direction);
+
+    bool active = false;
+    size_t workers = 1;
+    bool has_expensive_conversion = false;
+    bool has_color = false;
+    std::atomic<QualityLevel> current{QUALITY_FULL};
+
+    std::atomic<int64_t> convert_busy_ns{0};
+    std::atomic<int64_t> output_busy_ns{0};
+    std::atomic<uint64_t> drops{0};
+
+    // Only touched by update()
+    int64_t window_start_ns = 0;
+    int calm_windows = 0;          // windows in a row with headroom
+    int restore_after_windows = 0; // grows when a restored step had to be taken back soon after
+    int64_t last_restore_ns = 0;
+};
+
+#endif /* quality_controller_hpp */
@@ -0,0 +1,95 @@
+//
+//  spsc-queue.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef spsc_queue_hpp
+#define spsc_queue_hpp
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Bounded single-producer/single-consumer queue.
+// One thread calls push/try_push, one other thread calls pop/try_pop; no locks are taken.
+// The blocking variants back off while the queue is full/empty, which is how
+// the playback stages apply backpressure to each other.
+template <typename T>
+class SPSCQueue {
+public:
+    explicit SPSCQueue(size_t capacity) {
+        size_t slot_count = 1;
+        while (slot_count < capacity)
+            slot_count <<= 1;
+        slots.resize(slot_count);
+        mask = slot_count - 1;
+    }
+
+    SPSCQueue(const SPSCQueue &) = delete;
+    SPSCQueue &operator=(const SPSCQueue &) = delete;
+
+    // Moves item into the queue, returns false (and leaves item untouched) when full
+    bool try_push(T &item) {
+        size_t tail = tail_index.load(std::memory_order_relaxed);
+        if (tail - head_index.load(std::memory_order_acquire) > mask)
+            return false;
+        slots[tail & mask] = std::move(item);
+        tail_index.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T &item) {
+        size_t head = head_index.load(std::memory_order_relaxed);
+        if (head == tail_index.load(std::memory_order_acquire))
+            return false;
+        item = std::move(slots[head & mask]);
+        head_index.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Blocks while the queue is full, returns false if abort was raised meanwhile
+    bool push(T &item, const std::atomic<bool> &abort) {
+        for (int spins = 0; !try_push(item); ++spins) {
+            if (abort.load(std::memory_order_relaxed))
+                return false;
+            back_off(spins);
+        }
+        return true;
+    }
+
+    // Blocks while the queue is empty, returns false if abort was raised meanwhile
+    bool pop(T &item, const std::atomic<bool> &abort) {
+        for (int spins = 0; !try_pop(item); ++spins) {
+            if (abort.load(std::memory_order_relaxed))
+                return false;
+            back_off(spins);
+        }
+        return true;
+    }
+
+    // Approximate when read from a third thread, exact from the producer or consumer
+    size_t size() const {
+        return tail_index.load(std::memory_order_acquire) - head_index.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+private:
+    static void back_off(int spins) {
+        if (spins < 64)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head_index{0}; // 只由消费者写入
+    alignas(64) std::atomic<size_t> tail_index{0}; // 只由生产者写入
+};
+
+#endif /* spsc_queue_hpp */
@@ -0,0 +1,251 @@
+//
+//  terminal-input.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "terminal-input.hpp"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+// How long the rest of an escape sequence may take before ESC counts as a key press.
+// Terminals send a sequence in one write, a few ms are enough even over ssh.
+#define ESCAPE_TIMEOUT_MS 25
+
+bool KeySequenceParser::feed(uint8_t byte, PlayerCommand &command) {
+    switch (state) {
+        case STATE_GROUND:
+            if (byte == 0x1B) {
+                state = STATE_ESCAPE;
+                return false;
+            }
+            if (byte == 'q' || byte == 'Q') {
+                command = COMMAND_QUIT;
+                return true;
+            }
+            if (byte == 'h' || byte == 'H') {
+                command = COMMAND_TOGGLE_HUD;
+                return true;
+            }
+            return false;
+        case STATE_ESCAPE:
+            if (byte == '[') {
+                state = STATE_CSI;
+                return false;
+            }
+            if (byte == 'O') {
+                state = STATE_SS3;
+                return false;
+            }
+            // ESC ESC: the first one was a key press on its own
+            if (byte == 0x1B) {
+                command = COMMAND_QUIT;
+                return true;
+            }
+            state = STATE_GROUND; // Alt + key
+            return false;
+        case STATE_CSI:
+            // Parameters and intermediates (e.g. "1;5" of ctrl+right) until the final byte
+            if (byte >= 0x20 && byte < 0x40)
+                return false;
+            state = STATE_GROUND;
+            break;
+        case STATE_SS3:
+            state = STATE_GROUND;
+            break;
+    }
+
+    // Final byte of a CSI or SS3 sequence
+    switch (byte) {
+        case 'A':
+            command = COMMAND_VOLUME_UP;
+            return true;
+        case 'B':
+            command = COMMAND_VOLUME_DOWN;
+            return true;
+        case 'C':
+            command = COMMAND_SEEK_FORWARD;
+            return true;
+        case 'D':
+            command = COMMAND_SEEK_BACK;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool KeySequenceParser::timeout(PlayerCommand &command) {
+    if (state != STATE_ESCAPE) {
+        state = STATE_GROUND;
+        return false;
+    }
+    state = STATE_GROUND;
+    command = COMMAND_QUIT;
+    return true;
+}
+
+#ifdef _WIN32
+
+// The console keeps using GetAsyncKeyState, see is_escape_key_pressed
+TerminalInput::~TerminalInput() {}
+
+bool TerminalInput::start() {
+    return false;
+}
+
+void TerminalInput::stop() {}
+
+void TerminalInput::run() {}
+
+#else
+
+// What the signal handlers need to put the terminal back, only written while no handler is installed
+static int saved_tty_fd = -1;
+static struct termios saved_termios;
+static struct termios raw_termios;
+static volatile sig_atomic_t raw_mode_active = 0;
+
+static const int RESTORE_SIGNALS[] = {SIGINT, SIGTERM, SIGHUP, SIGQUIT, SIGTSTP, SIGCONT};
+static struct sigaction previous_actions[sizeof(RESTORE_SIGNALS) / sizeof(RESTORE_SIGNALS[0])];
+
+static void restore_terminal() {
+    if (raw_mode_active) {
+        tcsetattr(saved_tty_fd, TCSAFLUSH, &saved_termios);
+        raw_mode_active = 0;
+    }
+}
+
+// 只调用异步信号安全的函数
+static void restore_on_signal(int sig) {
+    int saved_errno = errno;
+    if (sig == SIGCONT) {
+        // Back from ctrl+z: raw mode again, and ready for the next suspend
+        if (saved_tty_fd >= 0 && !raw_mode_active) {
+            tcsetattr(saved_tty_fd, TCSAFLUSH, &raw_termios);
+            raw_mode_active = 1;
+        }
+        struct sigaction action = {};
+        action.sa_handler = restore_on_signal;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGTSTP, &action, nullptr);
+        errno = saved_errno;
+        return;
+    }
+    restore_terminal();
+    // Let the signal do what it would have done without us
+    for (size_t i = 0; i < sizeof(RESTORE_SIGNALS) / sizeof(RESTORE_SIGNALS[0]); ++i) {
+        if (RESTORE_SIGNALS[i] == sig)
+            sigaction(sig, &previous_actions[i], nullptr);
+    }
+    raise(sig);
+    errno = saved_errno;
+}
+
+static void install_signal_handlers(bool install) {
+    for (size_t i = 0; i < sizeof(RESTORE_SIGNALS) / sizeof(RESTORE_SIGNALS[0]); ++i) {
+        if (install) {
+            struct sigaction action = {};
+            action.sa_handler = restore_on_signal;
+            sigemptyset(&action.sa_mask);
+            sigaction(RESTORE_SIGNALS[i], &action, &previous_actions[i]);
+        } else {
+            sigaction(RESTORE_SIGNALS[i], &previous_actions[i], nullptr);
+        }
+    }
+}
+
+TerminalInput::~TerminalInput() {
+    stop();
+}
+
+bool TerminalInput::start() {
+    if (thread.joinable())
+        return true;
+    tty_fd = open("/dev/tty", O_RDONLY | O_NOCTTY | O_CLOEXEC);
+    if (tty_fd < 0)
+        return false;
+    if (tcgetattr(tty_fd, &saved_termios) < 0 || pipe(wake_pipe) < 0) {
+        close(tty_fd);
+        tty_fd = -1;
+        return false;
+    }
+
+    // No line buffering and no echo, ctrl+c and ctrl+z still raise their signals. Output is left alone.
+    raw_termios = saved_termios;
+    raw_termios.c_lflag &= ~(ICANON | ECHO);
+    raw_termios.c_iflag &= ~(IXON | ICRNL);
+    raw_termios.c_cc[VMIN] = 1;
+    raw_termios.c_cc[VTIME] = 0;
+    saved_tty_fd = tty_fd;
+
+    static bool exit_hook_registered = false;
+    if (!exit_hook_registered) {
+        exit_hook_registered = true;
+        atexit(restore_terminal);
+    }
+    install_signal_handlers(true);
+    if (tcsetattr(tty_fd, TCSAFLUSH, &raw_termios) == 0)
+        raw_mode_active = 1;
+
+    thread = std::thread(&TerminalInput::run, this);
+    return true;
+}
+
+void TerminalInput::stop() {
+    if (!thread.joinable())
+        return;
+    char wake = 0;
+    while (write(wake_pipe[1], &wake, 1) < 0 && errno == EINTR) {
+    }
+    thread.join();
+
+    restore_terminal();
+    install_signal_handlers(false);
+    saved_tty_fd = -1;
+    close(tty_fd);
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+    tty_fd = wake_pipe[0] = wake_pipe[1] = -1;
+}
+
+void TerminalInput::run() {
+    KeySequenceParser parser;
+    uint8_t bytes[64];
+    while (true) {
+        struct pollfd fds[2] = {{tty_fd, POLLIN, 0}, {wake_pipe[0], POLLIN, 0}};
+        // A lone ESC only waits as long as the rest of a sequence could take
+        int ready = ::poll(fds, 2, parser.pending_escape() ? ESCAPE_TIMEOUT_MS : -1);
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready < 0 || (fds[1].revents & POLLIN))
+            break;
+
+        PlayerCommand command;
+        if (ready == 0) {
+            if (parser.timeout(command))
+                commands.try_push(command);
+            continue;
+        }
+        ssize_t count = read(tty_fd, bytes, sizeof(bytes));
+        if (count < 0 && (errno == EINTR || errno == EAGAIN))
+            continue;
+        if (count <= 0)
+            break; // the terminal went away
+        for (ssize_t i = 0; i < count; ++i) {
+            // A full queue means the playback is not listening, the key is lost either way
+            if (parser.feed(bytes[i], command))
+                commands.try_push(command);
+        }
+    }
+}
+
+#endif
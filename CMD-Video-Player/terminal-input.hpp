@@ -0,0 +1,67 @@
+//
+//  terminal-input.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef terminal_input_hpp
+#define terminal_input_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "spsc-queue.hpp"
+
+enum PlayerCommand {
+    COMMAND_QUIT,         // ESC, q
+    COMMAND_SEEK_BACK,    // left arrow
+    COMMAND_SEEK_FORWARD, // right arrow
+    COMMAND_VOLUME_UP,    // up arrow
+    COMMAND_VOLUME_DOWN,  // down arrow
+    COMMAND_TOGGLE_HUD,   // h
+};
+
+// Turns the bytes a terminal sends for a key into commands: plain keys, ESC on its own,
+// and the CSI (ESC [ ... final) and SS3 (ESC O x) sequences of the arrow keys
+class KeySequenceParser {
+public:
+    // Returns true and sets command when byte completes a key that means something
+    bool feed(uint8_t byte, PlayerCommand &command);
+    // No byte followed for a while: a pending ESC was the key itself, not the start of a sequence
+    bool timeout(PlayerCommand &command);
+    bool pending_escape() const { return state == STATE_ESCAPE; }
+
+private:
+    enum State { STATE_GROUND, STATE_ESCAPE, STATE_CSI, STATE_SS3 };
+    State state = STATE_GROUND;
+};
+
+// Reads the controlling terminal in raw mode on a thread of its own and queues the commands
+// for the playback loop. Works without an SDL window and while the video comes from stdin,
+// since it opens /dev/tty. The terminal is put back on stop(), at exit and on fatal signals.
+class TerminalInput {
+public:
+    TerminalInput() : commands(64) {}
+    TerminalInput(const TerminalInput &) = delete;
+    TerminalInput &operator=(const TerminalInput &) = delete;
+    ~TerminalInput();
+
+    // False when there is no terminal to read (e.g. under a service manager) or on Windows
+    bool start();
+    void stop();
+
+    // Playback loop: takes the next command, never blocks
+    bool poll(PlayerCommand &command) { return commands.try_pop(command); }
+
+private:
+    void run();
+
+    SPSCQueue<PlayerCommand> commands;
+    std::thread thread;
+    int tty_fd = -1;
+    int wake_pipe[2] = {-1, -1};
+};
+
+#endif /* terminal_input_hpp */
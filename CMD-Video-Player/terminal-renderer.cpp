@@ -0,0 +1,302 @@
+//
+//  terminal-renderer.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "terminal-renderer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// A cursor move costs about this many bytes, shorter unchanged gaps are simply rewritten
+#define RUN_MERGE_GAP 8
+// Blank runs at least this long are skipped with \033[nC instead of printing spaces
+#define SPACE_SKIP_MIN 6
+
+void GlyphGrid::reset(int new_width, int new_height, bool with_colors, bool with_wide_glyphs) {
+    width = new_width;
+    height = new_height;
+    size_t count = static_cast<size_t>(width) * height;
+    cells.assign(count, ' ');
+    if (with_colors) {
+        fg.assign(count, COLOR_DEFAULT);
+        bg.assign(count, COLOR_DEFAULT);
+    } else {
+        fg.clear();
+        bg.clear();
+    }
+    if (with_wide_glyphs)
+        wide.assign(count, 0);
+    else
+        wide.clear();
+}
+
+static bool cell_differs(const GlyphGrid &a, const GlyphGrid &b, size_t i) {
+    return a.cells[i] != b.cells[i] || (a.colored() && (a.fg[i] != b.fg[i] || a.bg[i] != b.bg[i])) ||
+           (a.cells[i] == GLYPH_WIDE && a.has_wide() && a.wide[i] != b.wide[i]);
+}
+
+// A cell that a cleared screen or \033[K already shows
+static bool cell_blank(const GlyphGrid &grid, size_t i) {
+    return grid.cells[i] == ' ' && (!grid.colored() || grid.bg[i] == COLOR_DEFAULT);
+}
+
+static void append_color(OutputBuffer &out, uint32_t color, bool background) {
+    if (color == COLOR_DEFAULT) {
+        out.append(background ? "49" : "39", 2);
+    } else if (color & COLOR_PALETTE_FLAG) {
+        out.append(background ? "48;5;" : "38;5;", 5);
+        out.append_number(color & 0xFF);
+    } else {
+        out.append(background ? "48;2;" : "38;2;", 5);
+        out.append_number((color >> 16) & 0xFF);
+        out.append(';');
+        out.append_number((color >> 8) & 0xFF);
+        out.append(';');
+        out.append_number(color & 0xFF);
+    }
+}
+
+static void append_glyph(const GlyphGrid &grid, size_t i, OutputBuffer &out) {
+    char glyph = grid.cells[i];
+    if (glyph == GLYPH_UPPER_HALF) {
+        out.append("\xE2\x96\x80", 3); // ▀
+    } else if (glyph == GLYPH_WIDE && grid.has_wide()) {
+        // UTF-8, every code point used here is below U+10000
+        uint16_t code = grid.wide[i];
+        if (code < 0x800) {
+            out.append(static_cast<char>(0xC0 | (code >> 6)));
+        } else {
+            out.append(static_cast<char>(0xE0 | (code >> 12)));
+            out.append(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+        }
+        out.append(static_cast<char>(0x80 | (code & 0x3F)));
+    } else {
+        out.append(glyph);
+    }
+}
+
+void OutputBuffer::reserve(size_t extra) {
+    if (used + extra <= capacity)
+        return;
+    size_t new_capacity = std::max<size_t>(capacity * 2, used + extra);
+    std::unique_ptr<char[]> grown(new char[new_capacity]);
+    if (used)
+        memcpy(grown.get(), buffer.get(), used);
+    buffer.swap(grown);
+    capacity = new_capacity;
+}
+
+void OutputBuffer::append(const char *text, size_t length) {
+    reserve(length);
+    memcpy(buffer.get() + used, text, length);
+    used += length;
+}
+
+void OutputBuffer::append_number(unsigned value) {
+    char digits[10];
+    int count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value);
+    reserve(count);
+    while (count)
+        buffer[used++] = digits[--count];
+}
+
+void OutputBuffer::append_cursor_move(int row, int col) {
+    // ANSI 坐标从 1 开始
+    append("\033[", 2);
+    append_number(row + 1);
+    append(';');
+    append_number(col + 1);
+    append('H');
+}
+
+void OutputBuffer::append_cursor_forward(int columns) {
+    append("\033[", 2);
+    append_number(columns);
+    append('C');
+}
+
+bool OutputBuffer::write_to(FILE *stream) const {
+    fflush(stream);
+#ifdef _WIN32
+    int fd = _fileno(stream);
+#else
+    int fd = fileno(stream);
+#endif
+    size_t written = 0;
+    while (written < used) {
+#ifdef _WIN32
+        int n = _write(fd, buffer.get() + written, static_cast<unsigned>(used - written));
+#else
+        ssize_t n = write(fd, buffer.get() + written, used - written);
+#endif
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        written += n;
+    }
+    return true;
+}
+
+TerminalRenderer::TerminalRenderer(double full_redraw_threshold)
+    : full_redraw_threshold(full_redraw_threshold) {}
+
+void TerminalRenderer::invalidate() {
+    valid = false;
+}
+
+void TerminalRenderer::set_pen(uint32_t fg, uint32_t bg, OutputBuffer &out) {
+    bool fg_changed = fg != pen_fg, bg_changed = bg != pen_bg;
+    if (!fg_changed && !bg_changed)
+        return;
+    out.append("\033[", 2);
+    if (fg_changed)
+        append_color(out, fg, false);
+    if (fg_changed && bg_changed)
+        out.append(';');
+    if (bg_changed)
+        append_color(out, bg, true);
+    out.append('m');
+    pen_fg = fg;
+    pen_bg = bg;
+}
+
+size_t TerminalRenderer::render(const GlyphGrid &grid, OutputBuffer &out) {
+    size_t start_size = out.size();
+
+    full_redraw = !valid || grid.width != displayed.width || grid.height != displayed.height ||
+                  grid.colored() != displayed.colored() || grid.has_wide() != displayed.has_wide();
+    if (!full_redraw) {
+        size_t changed = 0;
+        for (size_t i = 0; i < grid.cells.size(); ++i) {
+            changed += cell_differs(grid, displayed, i);
+        }
+        full_redraw = changed > full_redraw_threshold * grid.cells.size();
+    }
+
+    if (full_redraw)
+        render_full(grid, out);
+    else
+        render_changes(grid, out);
+
+    // 每帧结束时恢复默认颜色，别的输出和下一帧都从默认颜色开始
+    if (pen_fg != COLOR_DEFAULT || pen_bg != COLOR_DEFAULT) {
+        out.append("\033[0m", 4);
+        pen_fg = pen_bg = COLOR_DEFAULT;
+    }
+    // Park the cursor below the grid
+    out.append_cursor_move(grid.height, 0);
+
+    displayed.width = grid.width;
+    displayed.height = grid.height;
+    displayed.cells = grid.cells;
+    displayed.fg = grid.fg;
+    displayed.bg = grid.bg;
+    displayed.wide = grid.wide;
+    valid = true;
+    return out.size() - start_size;
+}
+
+void TerminalRenderer::append_cells(const GlyphGrid &grid, size_t from, size_t to, OutputBuffer &out) {
+    if (!grid.colored() && !grid.has_wide()) {
+        out.append(grid.cells.data() + from, to - from);
+        return;
+    }
+    for (size_t i = from; i < to; ++i) {
+        // A space shows no foreground, keeping the old one saves an SGR
+        if (grid.colored())
+            set_pen(grid.cells[i] == ' ' ? pen_fg : grid.fg[i], grid.bg[i], out);
+        append_glyph(grid, i, out);
+    }
+}
+
+void TerminalRenderer::render_full(const GlyphGrid &grid, OutputBuffer &out) {
+    bool cleared = !valid;
+    if (cleared)
+        out.append("\033[2J", 4); // 尺寸变化或首帧时清屏
+    for (int y = 0; y < grid.height; ++y) {
+        size_t row_start = static_cast<size_t>(y) * grid.width;
+        int end = grid.width;
+        while (end > 0 && cell_blank(grid, row_start + end - 1))
+            end--;
+        if (end == 0 && cleared)
+            continue;
+        out.append_cursor_move(y, 0);
+
+        // After a clear the screen is already blank, long blank runs are jumped over
+        int x = 0;
+        while (x < end) {
+            int run = 0;
+            if (cleared) {
+                while (x + run < end && cell_blank(grid, row_start + x + run))
+                    run++;
+            }
+            if (run >= SPACE_SKIP_MIN) {
+                out.append_cursor_forward(run);
+                x += run;
+                continue;
+            }
+            int start = x;
+            x += std::max(run, 1);
+            while (x < end && !(cleared && cell_blank(grid, row_start + x)))
+                x++;
+            append_cells(grid, row_start + start, row_start + x, out);
+        }
+        // 行尾的空格用清除到行尾代替，清除用的是当前背景色
+        if (end < grid.width && !cleared) {
+            set_pen(pen_fg, COLOR_DEFAULT, out);
+            out.append("\033[K", 3);
+        }
+    }
+}
+
+void TerminalRenderer::render_changes(const GlyphGrid &grid, OutputBuffer &out) {
+    for (int y = 0; y < grid.height; ++y) {
+        size_t row_start = static_cast<size_t>(y) * grid.width;
+        bool row_changed = memcmp(grid.row(y), displayed.row(y), grid.width) != 0;
+        for (int x = 0; !row_changed && (grid.colored() || grid.has_wide()) && x < grid.width; ++x) {
+            row_changed = cell_differs(grid, displayed, row_start + x);
+        }
+        if (!row_changed)
+            continue;
+
+        int x = 0, cursor = -1; // cursor: column the terminal cursor is at on this row, -1 before the first run
+        while (x < grid.width) {
+            if (!cell_differs(grid, displayed, row_start + x)) {
+                x++;
+                continue;
+            }
+            // Extend the run over short unchanged gaps
+            int run_start = x, run_end = x + 1, gap = 0;
+            for (int i = run_end; i < grid.width && gap <= RUN_MERGE_GAP; ++i) {
+                if (cell_differs(grid, displayed, row_start + i)) {
+                    run_end = i + 1;
+                    gap = 0;
+                } else {
+                    gap++;
+                }
+            }
+            // Later runs on the same row only need a relative move
+            if (cursor < 0)
+                out.append_cursor_move(y, run_start);
+            else
+                out.append_cursor_forward(run_start - cursor);
+            append_cells(grid, row_start + run_start, row_start + run_end, out);
+            x = cursor = run_end;
+        }
+    }
+}
@@ -0,0 +1,107 @@
+//
+//  terminal-renderer.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef terminal_renderer_hpp
+#define terminal_renderer_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+// Cell colors: 0xRRGGBB, a 256-color palette index with COLOR_PALETTE_FLAG, or the terminal default
+#define COLOR_DEFAULT 0xFFFFFFFFu
+#define COLOR_PALETTE_FLAG 0x01000000u
+// Cell byte drawn as the upper half block, the top half takes the fg and the bottom half the bg color
+#define GLYPH_UPPER_HALF '\x01'
+// Cell byte drawn as the character in GlyphGrid::wide at the same index (block elements, Braille...)
+#define GLYPH_WIDE '\x02'
+
+// One screen of glyphs, row-major, width * height bytes
+struct GlyphGrid {
+    int width = 0;
+    int height = 0;
+    std::vector<char> cells;
+    // Foreground and background of every cell, empty for a monochrome grid
+    std::vector<uint32_t> fg;
+    std::vector<uint32_t> bg;
+    // Unicode code point of every GLYPH_WIDE cell, empty unless reset with wide glyphs
+    std::vector<uint16_t> wide;
+
+    // Resizes and blanks the grid, keeps the allocation when the size is unchanged
+    void reset(int new_width, int new_height, bool with_colors = false, bool with_wide_glyphs = false);
+    bool colored() const { return !fg.empty(); }
+    bool has_wide() const { return !wide.empty(); }
+    char *row(int y) { return cells.data() + static_cast<size_t>(y) * width; }
+    const char *row(int y) const { return cells.data() + static_cast<size_t>(y) * width; }
+    uint32_t *fg_row(int y) { return fg.data() + static_cast<size_t>(y) * width; }
+    uint32_t *bg_row(int y) { return bg.data() + static_cast<size_t>(y) * width; }
+    uint16_t *wide_row(int y) { return wide.data() + static_cast<size_t>(y) * width; }
+};
+
+// Byte arena that one frame of terminal output is assembled in. It is reused from frame
+// to frame and only ever grows, so a steady playback does not allocate here at all.
+class OutputBuffer {
+public:
+    void clear() { used = 0; }
+    const char *data() const { return buffer.get(); }
+    size_t size() const { return used; }
+
+    void append(const char *text, size_t length);
+    void append(char c) {
+        reserve(1);
+        buffer[used++] = c;
+    }
+    void append_number(unsigned value);
+    void append_cursor_move(int row, int col);
+    // \033[nC, moves right over cells that already show the right glyph
+    void append_cursor_forward(int columns);
+
+    // Flushes stream first so earlier stdio output stays in order, then hands
+    // the whole buffer to write(2)
+    bool write_to(FILE *stream) const;
+
+private:
+    void reserve(size_t extra);
+
+    std::unique_ptr<char[]> buffer;
+    size_t used = 0;
+    size_t capacity = 0;
+};
+
+// Remembers what is on the screen and turns the next grid into escape sequences
+// that only repaint the cells which changed.
+class TerminalRenderer {
+public:
+    // Above this share of changed cells a full redraw is cheaper than patching
+    explicit TerminalRenderer(double full_redraw_threshold = 0.5);
+
+    // Appends the bytes that bring the screen from the displayed grid to grid, returns how many
+    size_t render(const GlyphGrid &grid, OutputBuffer &out);
+
+    // Forgets the screen content, the next render clears the screen and redraws everything
+    void invalidate();
+
+    bool last_was_full_redraw() const { return full_redraw; }
+
+private:
+    void render_full(const GlyphGrid &grid, OutputBuffer &out);
+    void render_changes(const GlyphGrid &grid, OutputBuffer &out);
+    void append_cells(const GlyphGrid &grid, size_t from, size_t to, OutputBuffer &out);
+    // Emits one SGR for whatever differs from the current pen
+    void set_pen(uint32_t fg, uint32_t bg, OutputBuffer &out);
+
+    GlyphGrid displayed;
+    uint32_t pen_fg = COLOR_DEFAULT;
+    uint32_t pen_bg = COLOR_DEFAULT;
+    bool valid = false;
+    bool full_redraw = false;
+    double full_redraw_threshold;
+};
+
+#endif /* terminal_renderer_hpp */
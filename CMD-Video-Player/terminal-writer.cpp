@@ -0,0 +1,90 @@
+//
+//  terminal-writer.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "terminal-writer.hpp"
+
+#include <chrono>
+#include <utility>
+
+// state: index of the middle slot in the low bits, FRESH when it holds a frame not written yet,
+// REDRAW when that frame has to repaint the whole screen. Both are published together with the
+// slot, so a redraw applies to the frame it was requested for.
+// WAKE is flipped by stop() only to change the value a waiting writer sleeps on.
+#define SLOT_MASK 0x03
+#define SLOT_FRESH 0x04
+#define SLOT_WAKE 0x08
+#define SLOT_REDRAW 0x10
+
+static int64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TerminalWriter::TerminalWriter(FILE *stream) : stream(stream) {}
+
+TerminalWriter::~TerminalWriter() {
+    stop();
+}
+
+void TerminalWriter::start(WriteListener write_listener) {
+    if (thread.joinable())
+        return;
+    listener = std::move(write_listener);
+    stopping = false;
+    thread = std::thread(&TerminalWriter::run, this);
+}
+
+void TerminalWriter::stop() {
+    if (!thread.joinable())
+        return;
+    stopping = true;
+    state.fetch_xor(SLOT_WAKE, std::memory_order_acq_rel);
+    state.notify_one();
+    thread.join();
+}
+
+void TerminalWriter::submit(GlyphGrid &grid, bool redraw) {
+    std::swap(slots[back], grid);
+    uint8_t previous = state.load(std::memory_order_relaxed);
+    uint8_t next;
+    do {
+        // A replaced frame that was to repaint the screen passes that on, the terminal still needs it
+        bool redraw_pending = (previous & SLOT_FRESH) && (previous & SLOT_REDRAW);
+        next = static_cast<uint8_t>(back | SLOT_FRESH | (redraw || redraw_pending ? SLOT_REDRAW : 0));
+    } while (!state.compare_exchange_weak(previous, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+    if (previous & SLOT_FRESH)
+        superseded.fetch_add(1, std::memory_order_relaxed);
+    back = previous & SLOT_MASK;
+    state.notify_one();
+}
+
+void TerminalWriter::run() {
+    TerminalRenderer renderer;
+    OutputBuffer output;
+    while (true) {
+        uint8_t current = state.load(std::memory_order_acquire);
+        if (!(current & SLOT_FRESH)) {
+            // The last frame is written before stopping, so the screen ends on it
+            if (stopping.load(std::memory_order_acquire))
+                break;
+            state.wait(current, std::memory_order_acquire);
+            continue;
+        }
+        uint8_t previous = state.exchange(static_cast<uint8_t>(front), std::memory_order_acq_rel);
+        front = previous & SLOT_MASK;
+
+        int64_t start = steady_ns();
+        if (previous & SLOT_REDRAW)
+            renderer.invalidate();
+        output.clear();
+        renderer.render(slots[front], output);
+        // One write(2) per frame, write_to carries on with whatever a slow terminal did not take
+        output.write_to(stream);
+        written.fetch_add(1, std::memory_order_relaxed);
+        if (listener)
+            listener(steady_ns() - start, output.size());
+    }
+}
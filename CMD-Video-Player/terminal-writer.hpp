@@ -0,0 +1,63 @@
+//
+//  terminal-writer.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef terminal_writer_hpp
+#define terminal_writer_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <thread>
+
+#include "terminal-renderer.hpp"
+
+// Owns the terminal during a playback: frames are handed over through a triple buffer and a
+// thread of its own diffs and writes the newest one. When the terminal is slower than the
+// video (ssh, tmux, serial consoles) the frames it has not got to yet are replaced instead
+// of queued, and the thread scheduling the frames never waits for write(2).
+class TerminalWriter {
+public:
+    // Called on the writer thread after every frame with the time spent rendering and writing it
+    typedef std::function<void(int64_t write_ns, size_t bytes)> WriteListener;
+
+    explicit TerminalWriter(FILE *stream = stdout);
+    TerminalWriter(const TerminalWriter &) = delete;
+    TerminalWriter &operator=(const TerminalWriter &) = delete;
+    ~TerminalWriter();
+
+    void start(WriteListener listener = nullptr);
+    // Writes the frame still pending, if any, and joins the thread. Call it from the thread that submits.
+    void stop();
+
+    // Hands grid over and takes a spare buffer back in exchange, so grid is garbage afterwards.
+    // redraw repaints the whole screen, e.g. after a resize. Never blocks.
+    void submit(GlyphGrid &grid, bool redraw);
+
+    uint64_t frames_written() const { return written.load(std::memory_order_relaxed); }
+    // Submitted, but replaced by a newer frame before the writer got to them
+    uint64_t frames_superseded() const { return superseded.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+
+    FILE *stream;
+    WriteListener listener;
+    std::thread thread;
+    std::atomic<bool> stopping{false};
+
+    // Slot indices: back belongs to submit(), front to the writer, the one in between sits in state
+    GlyphGrid slots[3];
+    int back = 0;
+    int front = 1;
+    std::atomic<uint8_t> state{2};
+
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> superseded{0};
+};
+
+#endif /* terminal_writer_hpp */
@@ -0,0 +1,100 @@
+//
+//  thread-pool.cpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#include "thread-pool.hpp"
+
+#include <algorithm>
+#include <memory>
+
+#define MAX_BAND_THREADS 32
+
+ThreadPool::ThreadPool(size_t thread_count) {
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers.emplace_back(&ThreadPool::worker_func, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    task_ready.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+// Called and returns with the lock held, the job itself runs unlocked
+void ThreadPool::run_task(std::unique_lock<std::mutex> &lock, const Task &task) {
+    lock.unlock();
+    (*task.job)(task.begin, task.end);
+    lock.lock();
+    if (--task.batch->remaining == 0)
+        batch_done.notify_all();
+}
+
+void ThreadPool::worker_func() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        task_ready.wait(lock, [&] { return stopping || !tasks.empty(); });
+        if (tasks.empty())
+            return;
+        Task task = tasks.front();
+        tasks.pop_front();
+        run_task(lock, task);
+    }
+}
+
+void ThreadPool::parallel_for(int count, int min_band, const std::function<void(int, int)> &job) {
+    if (count <= 0)
+        return;
+    int band_count = std::min<int>(static_cast<int>(workers.size()) + 1, count / std::max(min_band, 1));
+    if (band_count <= 1) {
+        job(0, count);
+        return;
+    }
+
+    // 各条带行数尽量平均，前 count % band_count 条多一行
+    Batch batch = {band_count};
+    std::unique_lock<std::mutex> lock(mutex);
+    int begin = 0;
+    for (int i = 0; i < band_count; ++i) {
+        int end = begin + count / band_count + (i < count % band_count ? 1 : 0);
+        tasks.push_back({&job, begin, end, &batch});
+        begin = end;
+    }
+    task_ready.notify_all();
+
+    // Help with the queue instead of only waiting for it
+    while (batch.remaining > 0) {
+        if (!tasks.empty()) {
+            Task task = tasks.front();
+            tasks.pop_front();
+            run_task(lock, task);
+        } else {
+            batch_done.wait(lock, [&] { return batch.remaining == 0 || !tasks.empty(); });
+        }
+    }
+}
+
+static std::unique_ptr<ThreadPool> shared_band_pool = std::make_unique<ThreadPool>(0);
+
+ThreadPool &band_pool() {
+    return *shared_band_pool;
+}
+
+void resize_band_pool(size_t thread_count) {
+    thread_count = std::min<size_t>(thread_count, MAX_BAND_THREADS);
+    if (shared_band_pool->size() != thread_count)
+        shared_band_pool = std::make_unique<ThreadPool>(thread_count);
+}
+
+size_t default_band_threads() {
+    // 帧与帧之间已经由转换线程并行，这里只用一半核心
+    return std::clamp<size_t>(std::thread::hardware_concurrency() / 2, 1, 8);
+}
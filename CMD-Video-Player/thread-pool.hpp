@@ -0,0 +1,63 @@
+//
+//  thread-pool.hpp
+//  CMD-Video-Player
+//
+//  Created by Robert He on 2026/10/17.
+//
+
+#ifndef thread_pool_hpp
+#define thread_pool_hpp
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads that live as long as the pool and split row ranges into bands.
+// Several threads may call parallel_for at once; a caller works on queued bands
+// itself while it waits, so a busy pool never blocks it.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t thread_count);
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool();
+
+    size_t size() const { return workers.size(); }
+
+    // Runs job(begin, end) over bands of [0, count) of at least min_band rows each, on the pool
+    // and on the calling thread. Returns once every band is done.
+    void parallel_for(int count, int min_band, const std::function<void(int, int)> &job);
+
+private:
+    struct Batch {
+        int remaining;
+    };
+    struct Task {
+        const std::function<void(int, int)> *job;
+        int begin, end;
+        Batch *batch;
+    };
+
+    void worker_func();
+    void run_task(std::unique_lock<std::mutex> &lock, const Task &task);
+
+    std::vector<std::thread> workers;
+    std::deque<Task> tasks;
+    std::mutex mutex;
+    std::condition_variable task_ready, batch_done;
+    bool stopping = false;
+};
+
+// Pool for the glyph conversion of each frame, 0 threads until resize_band_pool is called
+ThreadPool &band_pool();
+// Replaces the pool with one of thread_count workers (0: bands run on the caller only).
+// Only call it while no conversion is running.
+void resize_band_pool(size_t thread_count);
+// Threads per frame when -j is not given, the pool has one less as the caller takes a band too
+size_t default_band_threads();
+
+#endif /* thread_pool_hpp */
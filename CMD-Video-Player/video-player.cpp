@@ -5,119 +5,81 @@
 //  Created by Robert He on 2024/9/2.
 //
 
+#include "ascii-cache.hpp"
 #include "basic-functions.hpp"
+#include "playlist.hpp"
+#include "probe-cache.hpp"
 #include "video-player.hpp"
 
-#define AUDIO_QUEUE_SIZE 1024 * 1024 // 1MB buffer
-
 bool is_escape_key_pressed() {
 #ifdef _WIN32
     // Windows-specific code to check if the ESC key is pressed
     return GetAsyncKeyState(VK_ESCAPE) & 0x8000;
 #else
-    // For Linux and macOS, we can implement a similar functionality if needed.
-    // Here, you could use termios.h or another library to handle keypresses.
-    return false; // Placeholder; you might want to implement platform-specific code here.
+    // Linux and macOS read the keys through TerminalInput
+    return false;
 #endif
 }
 
-struct AudioQueue {
-    uint8_t *data;
-    int size;
-    SDL_mutex *mutex;
-};
-
 const char *ASCII_SEQ_LONG = "@%#*+^=~-;:,'.` ";
 const char *ASCII_SEQ_SHORT = "@#*+-:. ";
 
-int volume = SDL_MIX_MAXVOLUME;
-SDL_AudioSpec audio_spec;
-
-// ANSI escape sequence to move the cursor to the top-left corner and clear the screen
-void move_cursor_to_top_left(bool clear = false) {
-    printf("\033[H"); // Moves the cursor to (0, 0) and clears the screen
-    if (clear)
-        printf("\033[2J");
-}
+// Bands smaller than this are not worth handing to another thread
+#define MIN_BAND_ROWS 8
 
-void add_empty_lines_for(std::string &combined_output, int count) {
-    for (int i = 0; i < count; i++) {
-        combined_output += "\n\033[K"; // 换行并清除该行到行末的字符
-    }
+// Writes the glyphs of image into grid with its top-left corner at (left, top).
+// Each band of rows goes straight into its own rows of grid.
+void image_to_ascii_with_lut(const cv::Mat &image, GlyphGrid &grid, int left, int top, const GlyphLUT &lut) {
+    band_pool().parallel_for(image.rows, MIN_BAND_ROWS, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            map_row_to_glyphs(lut, image.ptr<uchar>(i), grid.row(top + i) + left, image.cols);
+        }
+    });
 }
 
-std::string image_to_ascii_dy_contrast(const cv::Mat &image,
-                                       int pre_space = 0,
-                                       const char *asciiChars = ASCII_SEQ_SHORT) {
-    unsigned long asciiLength = strlen(asciiChars);
-    std::string asciiImage;
-
-    // Step 1: 计算图像的最小和最大像素值
-    double min_pixel_value, max_pixel_value;
-    cv::minMaxLoc(image, &min_pixel_value, &max_pixel_value);
+void image_to_ascii_dy_contrast(const cv::Mat &image,
+                                GlyphGrid &grid,
+                                int left = 0,
+                                int top = 0,
+                                const char *asciiChars = ASCII_SEQ_SHORT) {
+    // 计算图像的最小和最大像素值，灰度范围的缩放已经包含在查找表里
+    // Every band reduces its own rows first, the results are merged under a lock
+    double min_pixel_value = 255, max_pixel_value = 0;
+    std::mutex reduce_mutex;
+    band_pool().parallel_for(image.rows, MIN_BAND_ROWS, [&](int begin, int end) {
+        double band_min, band_max;
+        cv::minMaxLoc(image.rowRange(begin, end), &band_min, &band_max);
+        std::lock_guard<std::mutex> lock(reduce_mutex);
+        min_pixel_value = std::min(min_pixel_value, band_min);
+        max_pixel_value = std::max(max_pixel_value, band_max);
+    });
 
-    // Step 2: 遍历图像像素，并根据灰度范围缩放像素值
-    for (int i = 0; i < image.rows; ++i) {
-        asciiImage += std::string(pre_space, ' '); // 添加前置空格
-        for (int j = 0; j < image.cols; ++j) {
-            uchar pixel = image.at<uchar>(i, j);
-            // Step 3: 将像素值缩放到 0-255，并映射到 ASCII 字符集
-            uchar scaled_pixel = static_cast<uchar>(255.0 * (pixel - min_pixel_value) / (max_pixel_value - min_pixel_value));
-            char asciiChar = asciiChars[(scaled_pixel * asciiLength) / 256];
-            asciiImage += asciiChar;
-        }
-        if (pre_space)
-            asciiImage += "\033[K";
-        asciiImage += '\n';
-    }
-
-    return asciiImage;
+    const GlyphLUT &lut = get_glyph_lut(asciiChars, static_cast<int>(min_pixel_value), static_cast<int>(max_pixel_value));
+    image_to_ascii_with_lut(image, grid, left, top, lut);
 }
 
-std::string image_to_ascii(const cv::Mat &image, int pre_space = 0,
-                           const char *asciiChars = ASCII_SEQ_SHORT) {
+void image_to_ascii(const cv::Mat &image, GlyphGrid &grid, int left = 0, int top = 0,
+                    const char *asciiChars = ASCII_SEQ_SHORT) {
     // @%#*+=-:.
-    unsigned long asciiLength = strlen(asciiChars);
-    std::string asciiImage;
-
-    for (int i = 0; i < image.rows; ++i) {
-        asciiImage += std::string(pre_space, ' ');
-        for (int j = 0; j < image.cols; ++j) {
-            uchar pixel = image.at<uchar>(i, j);
-            char asciiChar = asciiChars[(pixel * asciiLength) / 256];
-            asciiImage += asciiChar;
-        }
-        if (pre_space)
-            asciiImage += "\033[K";
-        asciiImage += '\n';
-    }
-
-    return asciiImage;
+    image_to_ascii_with_lut(image, grid, left, top, get_glyph_lut(asciiChars));
 }
 
-std::string generate_ascii_image(const cv::Mat &image,
-                                 int pre_space,
-                                 const char *asciiChars,
-                                 std::string (*ascii_func)(const cv::Mat &, int, const char *)) {
+void generate_ascii_image(const cv::Mat &image,
+                          GlyphGrid &grid,
+                          int left,
+                          int top,
+                          const char *asciiChars,
+                          void (*ascii_func)(const cv::Mat &, GlyphGrid &, int, int, const char *)) {
     // 调用通过函数指针选择的生成方式
-    return ascii_func(image, pre_space, asciiChars);
-}
-
-std::string format_time(int64_t seconds) {
-    int64_t hours = seconds / 3600;
-    int64_t minutes = (seconds % 3600) / 60;
-    int64_t secs = seconds % 60;
-    std::stringstream ss;
-    ss << std::setfill('0') << std::setw(2) << hours << ":"
-       << std::setfill('0') << std::setw(2) << minutes << ":"
-       << std::setfill('0') << std::setw(2) << secs;
-    return ss.str();
+    ascii_func(image, grid, left, top, asciiChars);
 }
 
-std::string create_progress_bar(double progress, int width) {
-    int filled = static_cast<int>(progress * (width));
-    std::string bar = std::string(filled, '+') + std::string(width - filled, '-');
-    return bar;
+// Writes HH:MM:SS into buffer, returns its length
+int format_time(int64_t seconds, char *buffer, size_t size) {
+    long long hours = seconds / 3600;
+    long long minutes = (seconds % 3600) / 60;
+    long long secs = seconds % 60;
+    return std::clamp(snprintf(buffer, size, "%02lld:%02lld:%02lld", hours, minutes, secs), 0, static_cast<int>(size) - 1);
 }
 
 void list_audio_devices() {
@@ -162,365 +124,1296 @@ void print_audio_stream_info(AVStream *audio_stream, AVCodecContext *audio_codec
 }
 
 void audio_callback(void *userdata, Uint8 *stream, int len) {
-    AudioQueue *audio_queue = (AudioQueue *)userdata;
-    SDL_memset(stream, 0, len);
-    SDL_LockMutex(audio_queue->mutex);
+    AudioCallbackData *callback_data = (AudioCallbackData *)userdata;
+    AudioRingBuffer *audio_ring = callback_data->audio_ring;
+    int volume = callback_data->volume.load(std::memory_order_relaxed);
     int copied = 0;
-    while (copied < len && audio_queue->size > 0) {
-        int to_copy = std::min(len - copied, audio_queue->size);
-        
-        // Apply volume control
-        SDL_MixAudioFormat(stream + copied, audio_queue->data, AUDIO_S16SYS, to_copy, volume);
-        
-        audio_queue->size -= to_copy;
-        memmove(audio_queue->data, audio_queue->data + to_copy, audio_queue->size);
+    const uint8_t *data;
+    while (copied < len) {
+        int available = static_cast<int>(audio_ring->peek(&data));
+        if (available == 0)
+            break;
+        int to_copy = std::min(len - copied, available);
+
+        // Apply volume control, the ring only ever holds whole S16 samples
+        apply_gain_s16(reinterpret_cast<int16_t *>(stream + copied), reinterpret_cast<const int16_t *>(data), to_copy / 2, volume);
+
+        audio_ring->consume(to_copy);
         copied += to_copy;
     }
-    SDL_UnlockMutex(audio_queue->mutex);
+    if (copied < len)
+        SDL_memset(stream + copied, 0, len - copied);
+    if (copied > 0 && callback_data->clock)
+        callback_data->clock->audio_consumed(audio_ring->read_position());
+    if (copied < len && audio_ring->has_been_fed())
+        audio_ring->underruns++;
+}
+
+struct PacketItem {
+    AVPacket *packet = nullptr; // nullptr together with a new serial marks a seek flush
+    int serial = 0;
+    bool eos = false;
+};
+
+struct FrameItem {
+    AVFrame *frame = nullptr;
+    int serial = 0;
+    bool eos = false;
+};
+
+struct RenderedFrame {
+    GlyphGrid grid; // the whole screen, the last row is left blank for the status line
+    double pts = 0; // seconds
+    int term_width = 0;
+    int term_height = 0;
+    int serial = 0;
+    bool skip = false; // keeps the round-robin order when a worker drops a stale frame
+    bool eos = false;
+};
+
+// Shared state of one playback: demux -> video decode -> convert workers -> scheduling -> terminal writer
+struct PlaybackContext {
+    AVFormatContext *format_ctx = nullptr;
+    AVCodecContext *video_codec_ctx = nullptr;
+    AVCodecContext *audio_codec_ctx = nullptr;
+    AVStream *video_stream = nullptr;
+    AVStream *audio_stream = nullptr;
+    int video_stream_index = -1;
+    int audio_stream_index = -1;
+    SwrContext *swr_ctx = nullptr;
+    SDL_AudioSpec *spec = nullptr;
+    AudioRingBuffer *audio_ring = nullptr;
+    PipeInput *pipe_input = nullptr; // only for stdin and pipes
+    bool seekable = true;
+
+    const char *frame_chars = ASCII_SEQ_SHORT;
+    AsciiFunc generate_ascii_func;
+    AsciiFunc static_ascii_func; // what the quality controller falls back to
+    CellSampling cell_sampling;
+    ColorMode color_mode;
+    QualityController quality; // -ad
+    PlaybackStats stats;       // for the HUD
+
+    std::atomic<bool> abort{false};
+    std::atomic<int> serial{0};
+    std::atomic<bool> seek_request{false};
+    std::atomic<double> seek_target{0}; // seconds from start_time
+    double start_time = 0;              // seconds, pts of the first frame (not 0 in MPEG-TS or captures)
+    // Frames of the current serial before this pts are decoded but neither converted nor shown
+    std::atomic<double> display_from{-1};
+
+    // Keyframes for exact seeking, loaded from next to the video or scanned in the background
+    std::mutex keyframe_mutex;
+    std::shared_ptr<const KeyframeIndex> keyframe_index;
+
+    // A/V sync: video is scheduled against this clock, which follows the audio when there is any
+    PlaybackClock clock;
+    double late_frame_threshold = 0.1; // seconds behind the clock after which a frame is dropped
+    std::atomic<int64_t> last_present_ns{0};
+    std::atomic<uint64_t> frames_dropped_early{0}; // dropped by a worker before the conversion
+    std::atomic<uint64_t> frames_dropped_late{0};  // converted, but too late to show
+    std::atomic<uint64_t> frames_skipped{0};       // left out by the quality controller
+
+    // Read ahead before the playback started, see prefetch_media_input
+    std::vector<AVFrame *> prefetched_frames;   // handed out by the decode thread
+    std::vector<AVPacket *> prefetched_packets; // handled by the demux thread before it reads on
+
+    // Only touched by the demux thread
+    size_t prefetched_packet_index = 0;
+    double audio_skip_until = -1; // audio before this pts is not played after a seek
+    int audio_anchor_serial = -1;
+    uint64_t audio_anchor_pos = 0;
+    double audio_anchor_pts = 0;
+    std::vector<uint8_t> audio_buffer; // resampler output that does not fit into the ring in one piece
+
+    std::unique_ptr<SPSCQueue<PacketItem>> video_packets;
+    std::vector<std::unique_ptr<SPSCQueue<FrameItem>>> frame_queues;
+    std::vector<std::unique_ptr<SPSCQueue<RenderedFrame>>> output_queues;
+    // Grids the writer handed back, returned to the worker that converted into them
+    std::vector<std::unique_ptr<SPSCQueue<GlyphGrid>>> spare_grids;
+};
+
+const size_t VIDEO_PACKET_QUEUE_SIZE = 64;
+const size_t FRAME_QUEUE_SIZE = 4;
+const size_t OUTPUT_QUEUE_SIZE = 4;
+const auto AUDIO_BACKPRESSURE_TIMEOUT = std::chrono::milliseconds(500);
+const double AUDIO_RESYNC_THRESHOLD = 0.1; // seconds between expected and real audio pts before re-anchoring
+const double MAX_FRAME_WAIT = 1.0;         // a longer wait means the clock jumped, show the frame right away
+const auto DROP_GRACE_PERIOD = std::chrono::milliseconds(250); // never drop while nothing was shown for this long
+const int64_t HUD_REFRESH_NS = 500000000;                      // the HUD numbers are averages over this long
+const int64_t VOLUME_OVERLAY_NS = 2000000000;                  // the status line shows a volume change this long
+
+int64_t steady_clock_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double frame_pts_seconds(const AVFrame *frame, const AVStream *stream) {
+    int64_t pts = frame->best_effort_timestamp;
+    if (pts == AV_NOPTS_VALUE)
+        return -1;
+    return pts * av_q2d(stream->time_base);
+}
+
+// Dropping is only allowed once frames are being shown, otherwise a slow start would drop everything
+bool should_drop_frame(PlaybackContext &ctx, double pts) {
+    int64_t last_present = ctx.last_present_ns;
+    if (pts < 0 || last_present == 0)
+        return false;
+    if (steady_clock_ns() - last_present > std::chrono::nanoseconds(DROP_GRACE_PERIOD).count())
+        return false;
+    return pts < ctx.clock.now() - ctx.late_frame_threshold;
+}
+
+// Upper bound for the decoder's own frame/slice threads
+#define MAX_DECODER_THREADS 16
+// Reduced-quality decoding keeps at least this many source pixels per terminal column
+#define DECODE_OVERSAMPLE 2.0
+// From this many source pixels per column on the deblocking filter is skipped, from the second one B-frame IDCT too
+#define SKIP_LOOP_FILTER_RATIO 4.0
+#define SKIP_IDCT_RATIO 8.0
+
+int convert_worker_count() {
+    // demux、解码和终端输出各占一个线程，剩下的核心用于转换
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    return std::clamp(cores - 3, 1, 4);
+}
+
+// Ties the ring position of the chunk about to be written to its pts, once per seek or after a gap
+void anchor_audio_clock(PlaybackContext &ctx, const AVFrame *frame, int serial) {
+    double pts = frame_pts_seconds(frame, ctx.audio_stream);
+    if (pts < 0)
+        return;
+    uint64_t pos = ctx.audio_ring->write_position();
+    int bytes_per_second = ctx.spec->freq * ctx.spec->channels * 2;
+    double expected_pts = ctx.audio_anchor_pts + static_cast<double>(pos - ctx.audio_anchor_pos) / bytes_per_second;
+    if (ctx.audio_anchor_serial != serial || std::abs(expected_pts - pts) > AUDIO_RESYNC_THRESHOLD) {
+        ctx.audio_anchor_serial = serial;
+        ctx.audio_anchor_pos = pos;
+        ctx.audio_anchor_pts = pts;
+        ctx.clock.anchor_audio(pos, pts);
+    }
+}
+
+void decode_audio_packet(PlaybackContext &ctx, AVPacket *packet, AVFrame *frame, int serial) {
+    AudioRingBuffer &audio_ring = *ctx.audio_ring;
+    SDL_AudioSpec &spec = *ctx.spec;
+    const int bytes_per_sample = spec.channels * 2; // interleaved S16
+    if (avcodec_send_packet(ctx.audio_codec_ctx, packet) < 0)
+        return;
+    while (avcodec_receive_frame(ctx.audio_codec_ctx, frame) >= 0) {
+        // 跳转后从关键帧解码到目标位置之前的音频不播放
+        if (ctx.audio_skip_until >= 0) {
+            double pts = frame_pts_seconds(frame, ctx.audio_stream);
+            if (pts >= 0 && pts < ctx.audio_skip_until)
+                continue;
+        }
+        int out_samples = (int)av_rescale_rnd(swr_get_delay(ctx.swr_ctx, ctx.audio_codec_ctx->sample_rate) + frame->nb_samples,
+                                              spec.freq, ctx.audio_codec_ctx->sample_rate, AV_ROUND_UP);
+        size_t out_size = static_cast<size_t>(out_samples) * bytes_per_sample;
+
+        // Usually the ring has room in one piece, then the resampler writes straight into it
+        uint8_t *ring_space;
+        if (audio_ring.reserve(&ring_space) >= out_size) {
+            int samples_out = swr_convert(ctx.swr_ctx, &ring_space, out_samples,
+                                          (const uint8_t **)frame->data, frame->nb_samples);
+            if (samples_out > 0) {
+                anchor_audio_clock(ctx, frame, serial);
+                audio_ring.commit(static_cast<size_t>(samples_out) * bytes_per_sample);
+            }
+            continue;
+        }
+
+        // Near the wrap-around or with a full ring: convert into the reused buffer, which only ever grows
+        if (ctx.audio_buffer.size() < out_size)
+            ctx.audio_buffer.resize(out_size);
+        uint8_t *out_buffer = ctx.audio_buffer.data();
+        int samples_out = swr_convert(ctx.swr_ctx, &out_buffer, out_samples,
+                                      (const uint8_t **)frame->data, frame->nb_samples);
+        if (samples_out > 0) {
+            int buffer_size = samples_out * bytes_per_sample;
+            anchor_audio_clock(ctx, frame, serial);
+            // Backpressure: wait for the callback to drain, drop only if the device stopped consuming
+            auto give_up_time = std::chrono::steady_clock::now() + AUDIO_BACKPRESSURE_TIMEOUT;
+            while (!audio_ring.write(out_buffer, buffer_size)) {
+                if (ctx.abort || buffer_size > (int)audio_ring.capacity() || std::chrono::steady_clock::now() > give_up_time) {
+                    audio_ring.overflow_drops++;
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+        }
+    }
+}
+
+// Jumps to the last keyframe before target (seconds). The frames between that keyframe and
+// the target still have to be decoded, but nothing before the target is converted or played.
+void seek_to_keyframe(PlaybackContext &ctx, double target) {
+    // The target counts from the start of the video, timestamps from wherever the stream begins
+    target += ctx.start_time;
+    int64_t timestamp = static_cast<int64_t>(target / av_q2d(ctx.video_stream->time_base));
+    int64_t keyframe = timestamp;
+    {
+        std::lock_guard<std::mutex> lock(ctx.keyframe_mutex);
+        if (ctx.keyframe_index)
+            ctx.keyframe_index->find_before(timestamp, keyframe);
+    }
+    // Without an index the demuxer finds the keyframe itself, BACKWARD keeps it before the target
+    av_seek_frame(ctx.format_ctx, ctx.video_stream_index, keyframe, AVSEEK_FLAG_BACKWARD);
+    ctx.display_from = target;
+    ctx.audio_skip_until = target;
+}
+
+// Builds the keyframe index of a video that does not have one yet and saves it for the next time
+void keyframe_index_thread_func(PlaybackContext &ctx, std::string video_path) {
+    auto index = std::make_shared<KeyframeIndex>();
+    if (!index->scan(video_path, ctx.video_stream_index, ctx.abort))
+        return;
+    index->save(video_path);
+    std::lock_guard<std::mutex> lock(ctx.keyframe_mutex);
+    ctx.keyframe_index = index;
+}
+
+// Stage 1: reads packets, decodes audio inline and hands video packets to the decoder
+void demux_thread_func(PlaybackContext &ctx) {
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *audio_frame = av_frame_alloc();
+    int serial = ctx.serial;
+
+    while (!ctx.abort) {
+        if (ctx.seek_request.exchange(false)) {
+            // 预读的数据包在跳转之后就没用了
+            ctx.prefetched_packet_index = ctx.prefetched_packets.size();
+            seek_to_keyframe(ctx, ctx.seek_target);
+            serial = ++ctx.serial;
+            if (ctx.audio_codec_ctx) {
+                avcodec_flush_buffers(ctx.audio_codec_ctx);
+                ctx.audio_ring->discard_pending();
+            }
+            PacketItem flush_item;
+            flush_item.serial = serial;
+            if (!ctx.video_packets->push(flush_item, ctx.abort))
+                break;
+        }
+
+        if (ctx.prefetched_packet_index < ctx.prefetched_packets.size()) {
+            av_packet_move_ref(packet, ctx.prefetched_packets[ctx.prefetched_packet_index++]);
+        } else if (av_read_frame(ctx.format_ctx, packet) < 0) {
+            PacketItem eos_item;
+            eos_item.serial = serial;
+            eos_item.eos = true;
+            if (!ctx.video_packets->push(eos_item, ctx.abort))
+                break;
+            // The queues still hold the last seconds of the video: stay around, so a seek made
+            // while they play reads on from the new position
+            while (!ctx.abort && !ctx.seek_request)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+
+        if (packet->stream_index == ctx.video_stream_index) {
+            PacketItem item;
+            item.packet = av_packet_alloc();
+            item.serial = serial;
+            av_packet_move_ref(item.packet, packet);
+            if (!ctx.video_packets->push(item, ctx.abort)) {
+                av_packet_free(&item.packet);
+                break;
+            }
+        } else if (packet->stream_index == ctx.audio_stream_index && ctx.audio_codec_ctx && ctx.swr_ctx) {
+            decode_audio_packet(ctx, packet, audio_frame, serial);
+        }
+        av_packet_unref(packet);
+    }
+
+    av_frame_free(&audio_frame);
+    av_packet_free(&packet);
+}
+
+// Stage 2: decodes video packets and deals the frames round-robin to the convert workers
+void video_decode_thread_func(PlaybackContext &ctx) {
+    AVFrame *frame = av_frame_alloc();
+    size_t worker_count = ctx.frame_queues.size();
+    size_t frame_index = 0;
+    int serial = ctx.serial;
+    double display_from = -1;
+
+    // Time spent in the decoder, the frames it hands out carry it
+    auto receive_frame = [&]() {
+        int64_t start = steady_clock_ns();
+        bool received = avcodec_receive_frame(ctx.video_codec_ctx, frame) >= 0;
+        ctx.stats.add_stage_time(STAGE_DECODE, steady_clock_ns() - start, received);
+        return received;
+    };
+    auto deliver_frames = [&](int item_serial) {
+        while (receive_frame()) {
+            // Frames between the keyframe and the seek target never reach the workers
+            if (display_from >= 0) {
+                double pts = frame_pts_seconds(frame, ctx.video_stream);
+                if (pts >= 0 && pts < display_from) {
+                    av_frame_unref(frame);
+                    continue;
+                }
+            }
+            FrameItem frame_item;
+            frame_item.frame = av_frame_alloc();
+            frame_item.serial = item_serial;
+            av_frame_move_ref(frame_item.frame, frame);
+            if (!ctx.frame_queues[frame_index % worker_count]->push(frame_item, ctx.abort)) {
+                av_frame_free(&frame_item.frame);
+                return false;
+            }
+            frame_index++;
+        }
+        return true;
+    };
+
+    // The first GOP may have been decoded before the playback started
+    for (AVFrame *&prefetched : ctx.prefetched_frames) {
+        FrameItem frame_item;
+        frame_item.frame = prefetched;
+        frame_item.serial = serial;
+        if (!ctx.frame_queues[frame_index % worker_count]->push(frame_item, ctx.abort))
+            break;
+        prefetched = nullptr;
+        frame_index++;
+    }
+
+    PacketItem item;
+    while (ctx.video_packets->pop(item, ctx.abort)) {
+        if (item.serial != ctx.serial) {
+            // 跳转前残留的数据包
+            av_packet_free(&item.packet);
+            continue;
+        }
+        if (item.serial != serial) {
+            avcodec_flush_buffers(ctx.video_codec_ctx);
+            serial = item.serial;
+            display_from = ctx.display_from;
+        }
+        if (item.eos) {
+            avcodec_send_packet(ctx.video_codec_ctx, NULL);
+            if (!deliver_frames(serial))
+                break;
+            // Every worker gets an end marker, the scheduler meets one whichever worker is next.
+            // The decoder carries on: a seek afterwards sends a flush item with a new serial.
+            for (size_t i = 0; i < worker_count; ++i) {
+                FrameItem eos_item;
+                eos_item.serial = serial;
+                eos_item.eos = true;
+                if (!ctx.frame_queues[frame_index % worker_count]->push(eos_item, ctx.abort))
+                    break;
+                frame_index++;
+            }
+            continue;
+        }
+        if (!item.packet)
+            continue;
+
+        int64_t send_start = steady_clock_ns();
+        int ret = avcodec_send_packet(ctx.video_codec_ctx, item.packet);
+        ctx.stats.add_stage_time(STAGE_DECODE, steady_clock_ns() - send_start, 0);
+        av_packet_free(&item.packet);
+        if (ret >= 0 && !deliver_frames(serial))
+            break;
+    }
+
+    av_frame_free(&frame);
+}
+
+FrameLayout compute_frame_layout(int source_width, int source_height, int term_width, int term_height) {
+    FrameLayout layout;
+    layout.term_width = term_width;
+    layout.term_height = term_height;
+    layout.frame_width = term_width;
+    layout.frame_height = (source_height * layout.frame_width) / source_width / 2;
+    layout.left = 0;
+    layout.top = (term_height - layout.frame_height) / 2;
+    if (layout.frame_height > term_height) {
+        layout.frame_height = term_height;
+        layout.frame_width = (source_width * layout.frame_height * 2) / source_height;
+        layout.left = (term_width - layout.frame_width) / 2;
+        layout.top = 0;
+    }
+    return layout;
+}
+
+// Stage 3: scaling and ASCII conversion of one frame.
+// The scalers and scaled_frame belong to the worker and are reused as long as the terminal size stays the same.
+void convert_frame(PlaybackContext &ctx, const AVFrame *frame, LumaScaler &luma_scaler, cv::Mat &scaled_frame,
+                   ColorSampler &color_sampler, RenderedFrame &rendered) {
+    int termWidth, termHeight;
+
+    // Get terminal size and place the frame on it
+    get_terminal_size(termWidth, termHeight);
+    termHeight -= 2;
+    // The quality controller may shrink the picture, it stays centered on the terminal
+    int percent = ctx.quality.resolution_percent();
+    int areaWidth = termWidth * percent / 100, areaHeight = termHeight * percent / 100;
+    FrameLayout layout = compute_frame_layout(frame->width, frame->height, areaWidth, areaHeight);
+    layout.left += (termWidth - areaWidth) / 2;
+    layout.top += (termHeight - areaHeight) / 2;
+
+    bool static_conversion = ctx.quality.static_conversion();
+    const AsciiFunc &ascii_func = static_conversion ? ctx.static_ascii_func : ctx.generate_ascii_func;
+    CellSampling sampling = static_conversion ? CellSampling() : ctx.cell_sampling;
+    ColorMode color_mode = ctx.quality.color_disabled() ? ColorMode() : ctx.color_mode;
+
+    // Convert image to ASCII, centered in a grid with one extra row for the status line
+    bool colored = color_mode.depth != COLOR_DEPTH_NONE;
+    rendered.grid.reset(termWidth, termHeight + 1, colored, sampling.wide_glyphs);
+    if (layout.frame_width > 0 && layout.frame_height > 0) {
+        // Half blocks replace the glyphs, only the colors are needed then
+        int64_t scale_start = steady_clock_ns();
+        bool scaled = !color_mode.half_block &&
+                      luma_scaler.scale(frame, layout.frame_width * sampling.sub_x, layout.frame_height * sampling.sub_y, scaled_frame);
+        int64_t convert_start = steady_clock_ns();
+        ctx.stats.add_stage_time(STAGE_SCALE, convert_start - scale_start);
+        if (scaled)
+            ascii_func(scaled_frame, rendered.grid, layout.left, layout.top, ctx.frame_chars);
+        if (colored)
+            color_sampler.colorize(frame, color_mode, layout.left, layout.top, layout.frame_width, layout.frame_height, rendered.grid);
+        ctx.stats.add_stage_time(STAGE_CONVERT, steady_clock_ns() - convert_start);
+    }
+
+    rendered.term_width = termWidth;
+    rendered.term_height = termHeight;
+}
+
+void convert_thread_func(PlaybackContext &ctx, size_t worker_index) {
+    SPSCQueue<FrameItem> &input = *ctx.frame_queues[worker_index];
+    SPSCQueue<RenderedFrame> &output = *ctx.output_queues[worker_index];
+    SPSCQueue<GlyphGrid> &spare_grids = *ctx.spare_grids[worker_index];
+
+    LumaScaler luma_scaler;
+    cv::Mat scaled_frame;
+    ColorSampler color_sampler;
+    FrameItem item;
+    uint64_t frame_number = 0;
+    while (input.pop(item, ctx.abort)) {
+        RenderedFrame rendered;
+        rendered.serial = item.serial;
+        rendered.eos = item.eos;
+        if (item.frame && item.serial == ctx.serial) {
+            rendered.pts = frame_pts_seconds(item.frame, ctx.video_stream);
+            // Late frames are dropped here, before paying for the scaling and the conversion
+            if (should_drop_frame(ctx, rendered.pts)) {
+                ctx.frames_dropped_early++;
+                ctx.quality.frame_dropped();
+                rendered.skip = true;
+            } else if (ctx.quality.skip_conversion(frame_number++)) {
+                ctx.frames_skipped++;
+                rendered.skip = true;
+            } else {
+                // A grid the writer is done with keeps its allocation, reset() only blanks it
+                spare_grids.try_pop(rendered.grid);
+                int64_t convert_start = steady_clock_ns();
+                convert_frame(ctx, item.frame, luma_scaler, scaled_frame, color_sampler, rendered);
+                ctx.quality.add_convert_time(steady_clock_ns() - convert_start);
+            }
+        } else {
+            rendered.skip = true;
+        }
+        av_frame_free(&item.frame);
+
+        // End markers are passed on, the worker keeps running for a seek made after them
+        if (!output.push(rendered, ctx.abort))
+            break;
+    }
+}
+
+std::string format_queue_depths(const PlaybackContext &ctx) {
+    size_t frames = 0, frames_capacity = 0, outputs = 0, outputs_capacity = 0;
+    for (const auto &queue : ctx.frame_queues) {
+        frames += queue->size();
+        frames_capacity += queue->capacity();
+    }
+    for (const auto &queue : ctx.output_queues) {
+        outputs += queue->size();
+        outputs_capacity += queue->capacity();
+    }
+    std::stringstream ss;
+    ss << "[pkt " << ctx.video_packets->size() << "/" << ctx.video_packets->capacity()
+       << " frm " << frames << "/" << frames_capacity
+       << " out " << outputs << "/" << outputs_capacity
+       << " aud " << ctx.audio_ring->size() * 100 / ctx.audio_ring->capacity() << "%"
+       << " u" << ctx.audio_ring->underruns << " d" << ctx.audio_ring->overflow_drops;
+    if (ctx.pipe_input) {
+        ss << " in " << ctx.pipe_input->buffered() * 100 / ctx.pipe_input->capacity() << "%"
+           << " s" << ctx.pipe_input->stalls();
+    }
+    ss << " drop " << ctx.frames_dropped_early << "/" << ctx.frames_dropped_late;
+    if (ctx.quality.enabled())
+        ss << " skip " << ctx.frames_skipped;
+    ss << "] ";
+    return ss.str();
+}
+
+// One line of live numbers, built only when the HUD is visible and at most twice a second
+std::string format_hud(const PlaybackContext &ctx, const PlaybackStatsWindow &window, double target_fps, uint64_t superseded) {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1)
+       << "fps " << window.fps << "/" << target_fps
+       << " drop " << ctx.frames_dropped_early << "/" << ctx.frames_dropped_late << "/" << superseded
+       << " | dec " << window.stage_ms[STAGE_DECODE]
+       << " scl " << window.stage_ms[STAGE_SCALE]
+       << " cnv " << window.stage_ms[STAGE_CONVERT]
+       << " wr " << window.stage_ms[STAGE_WRITE] << " ms"
+       << " | " << window.bytes_per_frame / 1024 << " KB/f"
+       << " | aud " << ctx.audio_ring->size() * 100 / ctx.audio_ring->capacity() << "% u" << ctx.audio_ring->underruns
+       << std::showpos << std::setprecision(0) << " | a/v " << window.drift_ms << " ms";
+    return ss.str();
 }
 
-const std::map<std::string, std::function<std::string(const cv::Mat &, int, const char *)>> param_func_pair = {
+// The HUD takes the row right above the status line, over whatever the frame had there
+void draw_hud_line(GlyphGrid &grid, const std::string &text) {
+    if (grid.height < 2)
+        return;
+    int y = grid.height - 2;
+    char *row = grid.row(y);
+    int length = std::min(static_cast<int>(text.length()), grid.width);
+    memcpy(row, text.data(), length);
+    memset(row + length, ' ', grid.width - length);
+    if (grid.colored()) {
+        std::fill(grid.fg_row(y), grid.fg_row(y) + grid.width, COLOR_DEFAULT);
+        std::fill(grid.bg_row(y), grid.bg_row(y) + grid.width, COLOR_DEFAULT);
+    }
+}
+
+void request_seek(PlaybackContext &ctx, double target) {
+    ctx.seek_target = target;
+    ctx.seek_request = true;
+}
+
+const std::map<std::string, AsciiFunc> param_func_pair = {
     {"dy", image_to_ascii_dy_contrast},
-    {"st", image_to_ascii}};
+    {"st", image_to_ascii},
+    {"ed", [](const cv::Mat &image, GlyphGrid &grid, int left, int top, const char *chars) {
+         image_to_glyph_shapes(image, grid, left, top, chars, false);
+     }},
+    {"br", [](const cv::Mat &image, GlyphGrid &grid, int left, int top, const char *chars) {
+         image_to_braille(image, grid, left, top, chars, false);
+     }}};
+const std::map<std::string, CellSampling> cell_sampling_pairs = {
+    {"ed", {SHAPE_CELL_WIDTH, SHAPE_CELL_HEIGHT, true}},
+    {"br", {BRAILLE_CELL_WIDTH, BRAILLE_CELL_HEIGHT, true}}};
 const std::map<std::string, std::string> char_set_pairs = {
     {"s", ASCII_SEQ_SHORT},
     {"S", ASCII_SEQ_SHORT},
     {"l", ASCII_SEQ_LONG},
     {"L", ASCII_SEQ_LONG}};
+const std::map<std::string, ColorMode> color_mode_pairs = {
+    {"mono", {COLOR_DEPTH_NONE, false}},
+    {"256", {COLOR_DEPTH_256, false}},
+    {"true", {COLOR_DEPTH_TRUE, false}},
+    {"256h", {COLOR_DEPTH_256, true}},
+    {"trueh", {COLOR_DEPTH_TRUE, true}}};
 
-void play_video(const std::map<std::string, std::string> &params) {
-    std::string video_path;
-    const char *frame_chars;
-    std::function<std::string(const cv::Mat &, int, const char *)> generate_ascii_func = nullptr;
-
-    if (params_include(params, "-v")) {
-        video_path = params.at("-v");
-    } else {
-        print_error("No video but wanna play? Really? \nAdd a -v param, or type \"help\" to get usage");
-        return;
+AsciiFunc select_ascii_func(const std::map<std::string, std::string> &params) {
+    if (params_include(params, "-ct") && params_include(param_func_pair, params.at("-ct"))) {
+        // -dt: ordered dithering instead of a threshold per cell
+        if (params_include(params, "-dt") && params.at("-ct") == "ed")
+            return [](const cv::Mat &image, GlyphGrid &grid, int left, int top, const char *chars) {
+                image_to_glyph_shapes(image, grid, left, top, chars, true);
+            };
+        if (params_include(params, "-dt") && params.at("-ct") == "br")
+            return [](const cv::Mat &image, GlyphGrid &grid, int left, int top, const char *chars) {
+                image_to_braille(image, grid, left, top, chars, true);
+            };
+        return param_func_pair.at(params.at("-ct"));
     }
+    return image_to_ascii;
+}
 
-    if (params_include(params, "-ct") && params_include(param_func_pair, params.at("-ct"))) {
-        generate_ascii_func = param_func_pair.at(params.at("-ct"));
-    } else {
-        generate_ascii_func = image_to_ascii;
+CellSampling select_cell_sampling(const std::map<std::string, std::string> &params) {
+    if (params_include(params, "-ct") && params_include(cell_sampling_pairs, params.at("-ct"))) {
+        return cell_sampling_pairs.at(params.at("-ct"));
     }
+    return CellSampling();
+}
 
+// The returned pointer lives as long as params
+const char *select_frame_chars(const std::map<std::string, std::string> &params) {
     if (params_include(params, "-chars")) {
-        frame_chars = params.at("-chars").c_str();
+        return params.at("-chars").c_str();
     } else if (params_include(params, "-c") && params_include(char_set_pairs, params.at("-c"))) {
-        frame_chars = char_set_pairs.at(params.at("-c")).c_str();
-    } else {
-        frame_chars = ASCII_SEQ_SHORT;
+        return char_set_pairs.at(params.at("-c")).c_str();
     }
+    return ASCII_SEQ_SHORT;
+}
 
-    // Initialize FFmpeg
-    avformat_network_init();
+ColorMode select_color_mode(const std::map<std::string, std::string> &params) {
+    if (params_include(params, "-cm") && params_include(color_mode_pairs, params.at("-cm"))) {
+        return color_mode_pairs.at(params.at("-cm"));
+    }
+    return ColorMode();
+}
 
-    AVFormatContext *format_ctx = avformat_alloc_context();
-    if (avformat_open_input(&format_ctx, video_path.c_str(), NULL, NULL) < 0) {
-        print_error("Error: Could not open video file", video_path);
-        return;
+size_t select_band_threads(const std::map<std::string, std::string> &params) {
+    if (params_include(params, "-j")) {
+        try {
+            return std::max(std::stoi(params.at("-j")), 1);
+        } catch (const std::exception &) {
+            print_error("Invalid -j value, using the default", params.at("-j"));
+        }
+    }
+    return default_band_threads();
+}
+
+MediaInputOptions select_input_options(const std::map<std::string, std::string> &params) {
+    MediaInputOptions options;
+    if (params_include(params, "-ib")) {
+        try {
+            options.pipe_buffer_size = std::max(std::stoi(params.at("-ib")), 256) * (size_t)1024;
+        } catch (const std::exception &) {
+            print_error("Invalid -ib value, using the default", params.at("-ib"));
+        }
     }
+    options.memory_mapped = params_include(params, "-mm");
+    options.sampling = select_cell_sampling(params);
+    return options;
+}
+
+void configure_video_decoder(AVCodecContext *codec_ctx, const AVCodec *codec, int term_width, int term_height) {
+    int cores = static_cast<int>(std::thread::hardware_concurrency());
+    codec_ctx->thread_count = std::clamp(cores, 1, MAX_DECODER_THREADS);
+    codec_ctx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
 
-    if (avformat_find_stream_info(format_ctx, NULL) < 0) {
-        avformat_close_input(&format_ctx);
-        print_error("Error: Could not find stream info", video_path);
+    if (term_width <= 0 || term_height <= 2 || codec_ctx->width <= 0 || codec_ctx->height <= 0)
         return;
+    // Source pixels per terminal column, the same number of rows fall into half a cell
+    FrameLayout layout = compute_frame_layout(codec_ctx->width, codec_ctx->height, term_width, term_height - 2);
+    double ratio = static_cast<double>(codec_ctx->width) / std::max(layout.frame_width, 1);
+
+    // 保留至少 DECODE_OVERSAMPLE 倍的分辨率给缩放时做面积平均
+    int lowres = 0;
+    while (lowres < codec->max_lowres && ratio / (2 << lowres) >= DECODE_OVERSAMPLE)
+        lowres++;
+    codec_ctx->lowres = lowres;
+    if (ratio >= SKIP_LOOP_FILTER_RATIO) {
+        codec_ctx->skip_loop_filter = AVDISCARD_ALL;
+        codec_ctx->flags2 |= AV_CODEC_FLAG2_FAST;
     }
+    if (ratio >= SKIP_IDCT_RATIO)
+        codec_ctx->skip_idct = AVDISCARD_BIDIR;
+}
 
-    AVCodecContext *video_codec_ctx = nullptr;
-    AVCodecContext *audio_codec_ctx = nullptr;
-    AVStream *video_stream = nullptr;
-    AVStream *audio_stream = nullptr;
-    int video_stream_index = -1;
-    int audio_stream_index = -1;
+// A repeated open takes the probe results from the sidecar cache instead of decoding the first seconds again
+static bool find_stream_info(const std::string &path, AVFormatContext *format_ctx) {
+    if (apply_probe_cache(path, format_ctx))
+        return true;
+    if (avformat_find_stream_info(format_ctx, NULL) < 0)
+        return false;
+    save_probe_cache(path, format_ctx);
+    return true;
+}
+
+void draw_status_line(GlyphGrid &grid, const std::string &prefix, int64_t current_time, int64_t total_duration) {
+    if (grid.height == 0)
+        return;
+    char time_played[32], total_time[32];
+    int played_length = format_time(current_time, time_played, sizeof(time_played));
+    int total_length = format_time(total_duration, total_time, sizeof(total_time));
+    int progress_width = std::max(grid.width - (int)prefix.length() - played_length - total_length - 2, 0); // 2 for /
+    double progress = total_duration > 0 ? static_cast<double>(current_time) / total_duration : 0;
+    int filled = static_cast<int>(std::clamp(progress, 0.0, 1.0) * progress_width);
+
+    // prefix + time_played + "\\" + progress bar + "/" + total_time, written straight into the last row
+    char *row = grid.row(grid.height - 1);
+    int x = 0;
+    auto put = [&](const char *text, int length) {
+        length = std::min(length, grid.width - x);
+        if (length > 0) {
+            memcpy(row + x, text, length);
+            x += length;
+        }
+    };
+    auto fill = [&](char c, int count) {
+        count = std::min(count, grid.width - x);
+        if (count > 0) {
+            memset(row + x, c, count);
+            x += count;
+        }
+    };
+    put(prefix.data(), (int)prefix.length());
+    put(time_played, played_length);
+    put("\\", 1);
+    fill('+', filled);
+    fill('-', progress_width - filled);
+    put("/", 1);
+    put(total_time, total_length);
+}
+
+// Most packets read ahead for one input, and most frames decoded ahead of the playback.
+// Decoded frames are kept at the source resolution, so they are capped by size as well:
+// 32 MB is about 20 frames of 1080p or 2 of 4K, the rest of the GOP is decoded during playback.
+#define MAX_PREFETCH_PACKETS 512
+#define MAX_PREFETCH_PACKET_BYTES (16 * 1024 * 1024)
+#define MAX_PREFETCH_FRAMES 48
+#define MAX_PREFETCH_FRAME_BYTES (32 * 1024 * 1024)
+
+static size_t frame_buffer_bytes(const AVFrame *frame) {
+    size_t bytes = 0;
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && frame->buf[i]; ++i)
+        bytes += frame->buf[i]->size;
+    return bytes;
+}
+
+bool open_media_input(const std::string &path, int term_width, int term_height, MediaInput &input, std::string &error,
+                      const MediaInputOptions &options) {
+    input.path = path;
+    // Pipes go through our own read-ahead buffer, the demuxer then reads them without seeking
+    AVIOContext *custom_io = nullptr;
+    if (is_pipe_input_path(path)) {
+        input.pipe = std::make_unique<PipeInput>();
+        if (!input.pipe->open(path, options.pipe_buffer_size, error)) {
+            close_media_input(input);
+            return false;
+        }
+        custom_io = input.pipe->avio();
+    } else if (options.memory_mapped) {
+        // 映射不了（网络路径、Windows）就退回普通的文件读取
+        input.mapped = std::make_unique<MappedFileInput>();
+        std::string map_error;
+        if (input.mapped->open(path, map_error))
+            custom_io = input.mapped->avio();
+        else
+            input.mapped.reset();
+    }
+    if (custom_io) {
+        input.format_ctx = avformat_alloc_context();
+        input.format_ctx->pb = custom_io;
+        input.format_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+    }
+    // The file name still helps the demuxer guess the format of a mapped file
+    if (avformat_open_input(&input.format_ctx, input.pipe ? "" : path.c_str(), NULL, NULL) < 0) {
+        close_media_input(input);
+        error = "Error: Could not open video file";
+        return false;
+    }
+    if (!find_stream_info(path, input.format_ctx)) {
+        close_media_input(input);
+        error = "Error: Could not find stream info";
+        return false;
+    }
 
     // Find video and audio streams
+    AVFormatContext *format_ctx = input.format_ctx;
     for (int i = 0; i < format_ctx->nb_streams; ++i) {
         AVStream *stream = format_ctx->streams[i];
-        if (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && video_stream_index < 0) {
-            video_stream = stream;
-            video_stream_index = i;
-        } else if (stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO && audio_stream_index < 0) {
-            audio_stream = stream;
-            audio_stream_index = i;
+        if (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && input.video_stream_index < 0) {
+            input.video_stream_index = i;
+        } else if (stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO && input.audio_stream_index < 0) {
+            input.audio_stream_index = i;
         }
     }
-
-    if (!video_stream) {
-        avformat_close_input(&format_ctx);
-        print_error("Error: Could not find video stream.");
-        return;
+    if (input.video_stream_index < 0) {
+        close_media_input(input);
+        error = "Error: Could not find video stream.";
+        return false;
     }
 
     // Initialize video codec
+    AVStream *video_stream = format_ctx->streams[input.video_stream_index];
     const AVCodec *video_codec = avcodec_find_decoder(video_stream->codecpar->codec_id);
     if (!video_codec) {
-        avformat_close_input(&format_ctx);
-        print_error("Error: Could not find video codec.");
-        return;
+        close_media_input(input);
+        error = "Error: Could not find video codec.";
+        return false;
     }
-    video_codec_ctx = avcodec_alloc_context3(video_codec);
-    if (avcodec_parameters_to_context(video_codec_ctx, video_stream->codecpar) < 0) {
-        avformat_close_input(&format_ctx);
-        print_error("Error: Could not copy video codec parameters.");
-        return;
+    input.video_codec_ctx = avcodec_alloc_context3(video_codec);
+    if (avcodec_parameters_to_context(input.video_codec_ctx, video_stream->codecpar) < 0) {
+        close_media_input(input);
+        error = "Error: Could not copy video codec parameters.";
+        return false;
+    }
+    // Decode threads, and a cheaper decode when the picture ends up much smaller than the source
+    // Glyph renderers sampling several pixels per cell need that many more from the decoder
+    configure_video_decoder(input.video_codec_ctx, video_codec, term_width * options.sampling.sub_x,
+                            term_height * options.sampling.sub_y);
+    if (avcodec_open2(input.video_codec_ctx, video_codec, NULL) < 0) {
+        close_media_input(input);
+        error = "Error: Could not open video codec.";
+        return false;
+    }
+
+    // A video whose audio cannot be decoded is still played, silently
+    if (input.audio_stream_index >= 0) {
+        AVStream *audio_stream = format_ctx->streams[input.audio_stream_index];
+        const AVCodec *audio_codec = avcodec_find_decoder(audio_stream->codecpar->codec_id);
+        if (audio_codec)
+            input.audio_codec_ctx = avcodec_alloc_context3(audio_codec);
+        if (!input.audio_codec_ctx ||
+            avcodec_parameters_to_context(input.audio_codec_ctx, audio_stream->codecpar) < 0 ||
+            avcodec_open2(input.audio_codec_ctx, audio_codec, NULL) < 0) {
+            avcodec_free_context(&input.audio_codec_ctx);
+        }
     }
-    if (avcodec_open2(video_codec_ctx, video_codec, NULL) < 0) {
-        avcodec_free_context(&video_codec_ctx);
-        avformat_close_input(&format_ctx);
-        print_error("Error: Could not open video codec.");
+    return true;
+}
+
+void prefetch_media_input(MediaInput &input) {
+    AVPacket *packet = av_packet_alloc();
+    AVFrame *frame = av_frame_alloc();
+    int keyframes = 0;
+    size_t packet_bytes = 0, frame_bytes = 0;
+    bool decoding = true;
+    while (input.prefetched_packets.size() < MAX_PREFETCH_PACKETS && packet_bytes < MAX_PREFETCH_PACKET_BYTES) {
+        if (av_read_frame(input.format_ctx, packet) < 0)
+            break;
+        bool is_video = packet->stream_index == input.video_stream_index;
+        if (is_video && (packet->flags & AV_PKT_FLAG_KEY))
+            keyframes++;
+        if (!is_video || keyframes > 1 || !decoding) {
+            // 音频包、解码预算用完后的视频包和第一个 GOP 之后的视频包留给播放时的 demux 线程
+            packet_bytes += packet->size;
+            AVPacket *pending = av_packet_alloc();
+            av_packet_move_ref(pending, packet);
+            input.prefetched_packets.push_back(pending);
+            if (keyframes > 1)
+                break;
+            continue;
+        }
+        int ret = avcodec_send_packet(input.video_codec_ctx, packet);
+        av_packet_unref(packet);
+        while (ret >= 0 && avcodec_receive_frame(input.video_codec_ctx, frame) >= 0) {
+            AVFrame *decoded = av_frame_alloc();
+            av_frame_move_ref(decoded, frame);
+            frame_bytes += frame_buffer_bytes(decoded);
+            input.prefetched_frames.push_back(decoded);
+        }
+        // The decoder keeps its state, playback goes on from the next packet
+        decoding = input.prefetched_frames.size() < MAX_PREFETCH_FRAMES && frame_bytes < MAX_PREFETCH_FRAME_BYTES;
+    }
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+}
+
+void close_media_input(MediaInput &input) {
+    for (AVFrame *&frame : input.prefetched_frames)
+        av_frame_free(&frame);
+    input.prefetched_frames.clear();
+    for (AVPacket *&packet : input.prefetched_packets)
+        av_packet_free(&packet);
+    input.prefetched_packets.clear();
+    avcodec_free_context(&input.video_codec_ctx);
+    avcodec_free_context(&input.audio_codec_ctx);
+    avformat_close_input(&input.format_ctx);
+    // After the demuxer, which does not free a custom pb itself
+    input.pipe.reset();
+    input.mapped.reset();
+    input.video_stream_index = input.audio_stream_index = -1;
+}
+
+// Opens the device for the first audio stream, later inputs are resampled to its format
+static bool open_audio_output(AudioOutput &audio, const AVCodecContext *audio_codec_ctx,
+                              const std::map<std::string, std::string> &params) {
+    if (audio.device_id)
+        return true;
+    bool verbose = params_include(params, "-vb");
+    if (!audio.ring) {
+        // Initialize audio queue
+        size_t audio_queue_size = DEFAULT_AUDIO_QUEUE_SIZE;
+        if (params_include(params, "-aq")) {
+            try {
+                audio_queue_size = std::max(std::stoi(params.at("-aq")), 16) * (size_t)1024;
+            } catch (const std::exception &) {
+                print_error("Invalid -aq value, using the default", params.at("-aq"));
+            }
+        }
+        audio.ring = std::make_unique<AudioRingBuffer>(audio_queue_size);
+        audio.callback_data.audio_ring = audio.ring.get();
+    }
+    if (!audio.sdl_initialized) {
+        if (SDL_Init(SDL_INIT_AUDIO) < 0) {
+            print_error("SDL_Init Error: ", SDL_GetError());
+            return false;
+        }
+        audio.sdl_initialized = true;
+    }
+
+    SDL_AudioSpec wanted_spec;
+    wanted_spec.freq = audio_codec_ctx->sample_rate;
+    wanted_spec.format = AUDIO_S16SYS;
+    wanted_spec.channels = audio_codec_ctx->ch_layout.nb_channels;
+    wanted_spec.silence = 0;
+    wanted_spec.samples = 1024;
+    wanted_spec.callback = audio_callback;
+    wanted_spec.userdata = &audio.callback_data;
+
+    // int device_index = 1; // select_audio_device();
+    if (verbose)
+        list_audio_devices();
+    audio.device_id = SDL_OpenAudioDevice(NULL, 0, &wanted_spec, &audio.spec, 0);
+    if (audio.device_id == 0) {
+        print_error("SDL_OpenAudioDevice Error: ", SDL_GetError());
+        return false;
+    }
+    if (verbose) {
+        const char *device_name = SDL_GetAudioDeviceName(audio.device_id, 0);
+        std::cout << "Audio device opened successfully. Device ID: " << audio.device_id << std::endl;
+        std::cout << "Using audio device: " << device_name << std::endl;
+        std::cout << "Actual audio spec - freq: " << audio.spec.freq
+                  << ", format: " << SDL_AUDIO_BITSIZE(audio.spec.format) << " bit"
+                  << ", channels: " << (int)audio.spec.channels << std::endl;
+    }
+    SDL_PauseAudioDevice(audio.device_id, 0);
+    if (verbose)
+        std::cout << "Audio device unpaused." << std::endl;
+    return true;
+}
+
+void close_audio_output(AudioOutput &audio) {
+    if (audio.device_id) {
+        SDL_CloseAudioDevice(audio.device_id);
+        audio.device_id = 0;
+    }
+    if (audio.sdl_initialized) {
+        SDL_Quit();
+        audio.sdl_initialized = false;
+    }
+}
+
+// Points the audio callback at the clock of the playback that is about to start, or at nothing
+static void attach_audio_clock(AudioOutput &audio, PlaybackClock *clock) {
+    if (!audio.device_id) {
+        audio.callback_data.clock = clock;
         return;
     }
+    SDL_LockAudioDevice(audio.device_id);
+    audio.callback_data.clock = clock;
+    SDL_UnlockAudioDevice(audio.device_id);
+}
+
+bool play_media_input(MediaInput &input, const std::map<std::string, std::string> &params, AudioOutput &audio) {
+    const std::string &video_path = input.path;
+    bool show_queue_depths = params_include(params, "-qd");
+    AVFormatContext *format_ctx = input.format_ctx;
+    AVStream *video_stream = format_ctx->streams[input.video_stream_index];
+    AVStream *audio_stream = input.audio_codec_ctx ? format_ctx->streams[input.audio_stream_index] : nullptr;
 
-    // Initialize audio queue
-    AudioQueue audio_queue;
-    audio_queue.data = new uint8_t[AUDIO_QUEUE_SIZE];
-    audio_queue.size = 0;
-    audio_queue.mutex = SDL_CreateMutex();
+    PlaybackContext ctx;
+    resize_band_pool(select_band_threads(params) - 1);
 
-    // Initialize SDL audio if audio stream exists
-    SDL_AudioSpec wanted_spec, spec;
-    SDL_AudioDeviceID audio_device_id = 0;
+    // Audio goes through the shared device, resampled to whatever format it was opened with
     SwrContext *swr_ctx = nullptr;
     if (audio_stream) {
-        const AVCodec *audio_codec = avcodec_find_decoder(audio_stream->codecpar->codec_id);
-        if (!audio_codec) {
-            print_error("Error: Could not find audio codec.");
-        } else {
-            audio_codec_ctx = avcodec_alloc_context3(audio_codec);
-            if (avcodec_parameters_to_context(audio_codec_ctx, audio_stream->codecpar) < 0) {
-                print_error("Error: Could not copy audio codec parameters.");
-            } else if (avcodec_open2(audio_codec_ctx, audio_codec, NULL) < 0) {
-                avcodec_free_context(&audio_codec_ctx);
-                print_error("Error: Could not open audio codec.");
+        if (params_include(params, "-vb"))
+            print_audio_stream_info(audio_stream, input.audio_codec_ctx);
+        if (open_audio_output(audio, input.audio_codec_ctx, params)) {
+            ctx.clock.set_audio_format(audio.spec.freq * audio.spec.channels * 2, audio.spec.size);
+            swr_ctx = swr_alloc();
+            if (!swr_ctx) {
+                print_error("Error: Could not allocate SwrContext.");
             } else {
-                print_audio_stream_info(audio_stream, audio_codec_ctx);
-                if (SDL_Init(SDL_INIT_AUDIO) < 0) {
-                    print_error("SDL_Init Error: ", SDL_GetError());
-                } else {
-                    wanted_spec.freq = audio_codec_ctx->sample_rate;
-                    wanted_spec.format = AUDIO_S16SYS;
-                    wanted_spec.channels = audio_codec_ctx->ch_layout.nb_channels;
-                    wanted_spec.silence = 0;
-                    wanted_spec.samples = 1024;
-                    wanted_spec.callback = audio_callback;
-                    wanted_spec.userdata = &audio_queue;
-
-                    // int device_index = 1; // select_audio_device();
-                    list_audio_devices();
-                    audio_device_id = SDL_OpenAudioDevice(NULL, 0, &wanted_spec, &spec, 0);
-                    const char *device_name = SDL_GetAudioDeviceName(audio_device_id, 0);
-                    if (audio_device_id == 0) {
-                        print_error("SDL_OpenAudioDevice Error: ", SDL_GetError());
-                    } else {
-                        std::cout << "Audio device opened successfully. Device ID: " << audio_device_id << std::endl;
-                        std::cout << "Using audio device: " << device_name << std::endl;
-                        std::cout << "Actual audio spec - freq: " << spec.freq
-                                  << ", format: " << SDL_AUDIO_BITSIZE(spec.format) << " bit"
-                                  << ", channels: " << (int)spec.channels << std::endl;
-                        swr_ctx = swr_alloc();
-                        if (!swr_ctx) {
-                            print_error("Error: Could not allocate SwrContext.");
-                        } else {
-                            AVChannelLayout out_ch_layout = AV_CHANNEL_LAYOUT_STEREO;
-                            if (swr_alloc_set_opts2(&swr_ctx, &out_ch_layout, AV_SAMPLE_FMT_S16, spec.freq,
-                                                    &audio_codec_ctx->ch_layout, audio_codec_ctx->sample_fmt, audio_codec_ctx->sample_rate,
-                                                    0, NULL) < 0) {
-                                print_error("Error: Could not set SwrContext options.");
-                                swr_free(&swr_ctx);
-                            } else if (swr_init(swr_ctx) < 0) {
-                                print_error("Error: Could not initialize SwrContext.");
-                                swr_free(&swr_ctx);
-                            } else {
-                                std::cout << "Audio resampling context initialized successfully." << std::endl;
-                            }
-                        }
-                        SDL_PauseAudioDevice(audio_device_id, 0);
-                        std::cout << "Audio device unpaused." << std::endl;
-                    }
+                // The layout the device was opened with, which may differ from the stream's
+                AVChannelLayout out_ch_layout;
+                av_channel_layout_default(&out_ch_layout, audio.spec.channels);
+                if (swr_alloc_set_opts2(&swr_ctx, &out_ch_layout, AV_SAMPLE_FMT_S16, audio.spec.freq,
+                                        &input.audio_codec_ctx->ch_layout, input.audio_codec_ctx->sample_fmt, input.audio_codec_ctx->sample_rate,
+                                        0, NULL) < 0) {
+                    print_error("Error: Could not set SwrContext options.");
+                    swr_free(&swr_ctx);
+                } else if (swr_init(swr_ctx) < 0) {
+                    print_error("Error: Could not initialize SwrContext.");
+                    swr_free(&swr_ctx);
+                } else if (params_include(params, "-vb")) {
+                    std::cout << "Audio resampling context initialized successfully." << std::endl;
                 }
             }
         }
-    } else {
+    } else if (params_include(params, "-vb")) {
         std::cout << "No audio stream found in the video." << std::endl;
     }
+    // Without a device nothing reads the ring, a video without sound still needs one for the status line
+    if (!audio.ring) {
+        audio.ring = std::make_unique<AudioRingBuffer>();
+        audio.callback_data.audio_ring = audio.ring.get();
+    }
+    attach_audio_clock(audio, &ctx.clock);
 
-    AVPacket *packet = av_packet_alloc();
-    AVFrame *frame = av_frame_alloc();
-    if (!packet || !frame) {
-        print_error("Error: Could not allocate packet or frame.");
-        // Clean up and return
-        // ... (cleanup code)
-        return;
+    ctx.format_ctx = format_ctx;
+    ctx.video_codec_ctx = input.video_codec_ctx;
+    ctx.audio_codec_ctx = input.audio_codec_ctx;
+    ctx.video_stream = video_stream;
+    ctx.audio_stream = audio_stream;
+    ctx.video_stream_index = input.video_stream_index;
+    ctx.audio_stream_index = input.audio_stream_index;
+    ctx.swr_ctx = swr_ctx;
+    ctx.spec = &audio.spec;
+    ctx.audio_ring = audio.ring.get();
+    ctx.pipe_input = input.pipe.get();
+    if (video_stream->start_time != AV_NOPTS_VALUE)
+        ctx.start_time = video_stream->start_time * av_q2d(video_stream->time_base);
+    else if (format_ctx->start_time != AV_NOPTS_VALUE)
+        ctx.start_time = static_cast<double>(format_ctx->start_time) / AV_TIME_BASE;
+    ctx.seekable = !format_ctx->pb || (format_ctx->pb->seekable & AVIO_SEEKABLE_NORMAL);
+    ctx.frame_chars = select_frame_chars(params);
+    ctx.generate_ascii_func = select_ascii_func(params);
+    ctx.cell_sampling = select_cell_sampling(params);
+    ctx.color_mode = select_color_mode(params);
+    ctx.static_ascii_func = image_to_ascii;
+    ctx.prefetched_frames.swap(input.prefetched_frames);
+    ctx.prefetched_packets.swap(input.prefetched_packets);
+
+    size_t worker_count = convert_worker_count();
+    ctx.video_packets = std::make_unique<SPSCQueue<PacketItem>>(VIDEO_PACKET_QUEUE_SIZE);
+    for (size_t i = 0; i < worker_count; ++i) {
+        ctx.frame_queues.push_back(std::make_unique<SPSCQueue<FrameItem>>(FRAME_QUEUE_SIZE));
+        ctx.output_queues.push_back(std::make_unique<SPSCQueue<RenderedFrame>>(OUTPUT_QUEUE_SIZE));
+        ctx.spare_grids.push_back(std::make_unique<SPSCQueue<GlyphGrid>>(OUTPUT_QUEUE_SIZE));
     }
-    int64_t total_duration = format_ctx->duration / AV_TIME_BASE;
+
+    // Streams read from a pipe usually have no duration
+    int64_t total_duration = format_ctx->duration > 0 ? format_ctx->duration / AV_TIME_BASE : 0;
     int64_t current_time = 0;
 
     double fps = av_q2d(video_stream->avg_frame_rate);
-    int frame_delay = static_cast<int>(1000.0 / fps);
-    int termWidth, termHeight, frameWidth, frameHeight, prevTermWidth = 0, prevTermHeight = 0, w_space_count = 0, h_line_count = 0;
+    if (fps > 0)
+        ctx.late_frame_threshold = std::clamp(1.0 / fps, 0.04, 0.1);
+    bool expensive_conversion = params_include(params, "-ct") && params_include(param_func_pair, params.at("-ct")) &&
+                                params.at("-ct") != "st";
+    ctx.quality.configure(params_include(params, "-ad"), worker_count, expensive_conversion,
+                          ctx.color_mode.depth != COLOR_DEPTH_NONE);
+    int prevTermWidth = 0, prevTermHeight = 0, displayed_serial = -1;
+    double displayed_pts = 0; // seconds from start_time, like seek_target
+    size_t output_index = 0;
 
     bool quit = false, term_size_changed = true;
-    int volume = SDL_MIX_MAXVOLUME;
+    // h toggles the HUD, -hud starts with it
+    bool show_hud = params_include(params, "-hud");
+    std::string hud_text;
+    int64_t hud_refresh_ns = 0;
+    std::atomic<int> &volume = audio.callback_data.volume;
+    int64_t volume_shown_until_ns = 0; // stdout belongs to the writer, so the volume goes into the status line
     int seek_offset = 5; // 快进/快退 5 秒
-    
-    SDL_Event event;
 
-    while (!quit && av_read_frame(format_ctx, packet) >= 0) {
-        auto start_time = std::chrono::high_resolution_clock::now();
+    // Stage 5 on a thread of its own, a slow terminal must not hold up the frame scheduling
+    TerminalWriter writer;
+    uint64_t superseded_seen = 0;
+    writer.start([&ctx](int64_t write_ns, size_t bytes) {
+        ctx.quality.add_output_time(write_ns);
+        ctx.stats.add_stage_time(STAGE_WRITE, write_ns);
+        ctx.stats.frame_written(bytes);
+    });
+
+    std::vector<std::thread> threads;
+    auto keyframe_index = std::make_shared<KeyframeIndex>();
+    std::error_code fs_error;
+    if (keyframe_index->load(video_path, input.video_stream_index)) {
+        ctx.keyframe_index = keyframe_index;
+    } else if (std::filesystem::is_regular_file(video_path, fs_error)) {
+        threads.emplace_back(keyframe_index_thread_func, std::ref(ctx), video_path);
+    }
+    threads.emplace_back(demux_thread_func, std::ref(ctx));
+    threads.emplace_back(video_decode_thread_func, std::ref(ctx));
+    for (size_t i = 0; i < worker_count; ++i) {
+        threads.emplace_back(convert_thread_func, std::ref(ctx), i);
+    }
 
+    auto handle_command = [&](PlayerCommand command) {
+        switch (command) {
+            case COMMAND_QUIT:
+                quit = true;
+                break;
+            case COMMAND_SEEK_BACK:
+            case COMMAND_SEEK_FORWARD: {
+                if (!ctx.seekable)
+                    break;
+                // Repeated presses add up even before the previous jump shows a frame
+                double position = displayed_serial == ctx.serial ? displayed_pts : ctx.seek_target.load();
+                double offset = command == COMMAND_SEEK_BACK ? -seek_offset : seek_offset;
+                request_seek(ctx, std::clamp(position + offset, 0.0, std::max<double>(total_duration - 1, 0)));
+                break;
+            }
+            case COMMAND_VOLUME_UP:
+                volume = std::min(volume + AUDIO_GAIN_UNITY / 10, AUDIO_GAIN_UNITY);
+                volume_shown_until_ns = steady_clock_ns() + VOLUME_OVERLAY_NS;
+                break;
+            case COMMAND_VOLUME_DOWN:
+                volume = std::max(volume - AUDIO_GAIN_UNITY / 10, 0);
+                volume_shown_until_ns = steady_clock_ns() + VOLUME_OVERLAY_NS;
+                break;
+            case COMMAND_TOGGLE_HUD:
+                show_hud = !show_hud;
+                hud_refresh_ns = 0;
+                ctx.stats.take_window(steady_clock_ns()); // the first numbers shown start from now
+                break;
+        }
+    };
+    const std::map<SDL_Keycode, PlayerCommand> sdl_key_commands = {
+        {SDLK_ESCAPE, COMMAND_QUIT},
+        {SDLK_LEFT, COMMAND_SEEK_BACK},
+        {SDLK_RIGHT, COMMAND_SEEK_FORWARD},
+        {SDLK_UP, COMMAND_VOLUME_UP},
+        {SDLK_DOWN, COMMAND_VOLUME_DOWN},
+        {SDLK_h, COMMAND_TOGGLE_HUD}};
+
+    // Keys come from the terminal itself, SDL only sees them when it has a window
+    TerminalInput terminal_input;
+    terminal_input.start();
+    SDL_Event event;
+    PlayerCommand command;
+
+    // Stage 4: frames are scheduled on this thread, in decode order across the workers
+    while (!quit) {
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) {
                 quit = true;
-            } else if (event.type == SDL_KEYDOWN) {
-                switch (event.key.keysym.sym) {
-                    case SDLK_ESCAPE:
-                        quit = true;
-                        break;
-                    case SDLK_LEFT:
-                        av_seek_frame(format_ctx, -1, current_time - seek_offset, AVSEEK_FLAG_BACKWARD | AVSEEK_FLAG_ANY);
-                        avcodec_flush_buffers(video_codec_ctx);
-                        if (audio_codec_ctx) avcodec_flush_buffers(audio_codec_ctx);
-                        break;
-                    case SDLK_RIGHT:
-                        av_seek_frame(format_ctx, -1, current_time + seek_offset, AVSEEK_FLAG_ANY);
-                        avcodec_flush_buffers(video_codec_ctx);
-                        if (audio_codec_ctx) avcodec_flush_buffers(audio_codec_ctx);
-                        break;
-                    case SDLK_UP:
-                        volume = std::min(volume + SDL_MIX_MAXVOLUME / 10, SDL_MIX_MAXVOLUME);
-                        std::cout << "Volume increased to " << (volume * 100 / SDL_MIX_MAXVOLUME) << "%" << std::endl;
-                        break;
-                    case SDLK_DOWN:
-                        volume = std::max(volume - SDL_MIX_MAXVOLUME / 10, 0);
-                        std::cout << "Volume decreased to " << (volume * 100 / SDL_MIX_MAXVOLUME) << "%" << std::endl;
-                        break;
-                }
+            } else if (event.type == SDL_KEYDOWN && sdl_key_commands.count(event.key.keysym.sym)) {
+                handle_command(sdl_key_commands.at(event.key.keysym.sym));
             }
         }
+        // Checked before every frame, so a key takes effect within one frame
+        while (terminal_input.poll(command)) {
+            handle_command(command);
+        }
 
-        if (packet->stream_index == video_stream_index) {
-            if (avcodec_send_packet(video_codec_ctx, packet) >= 0) {
-                while (avcodec_receive_frame(video_codec_ctx, frame) >= 0) {
-                    // Convert to grayscale image
-                    cv::Mat grayFrame(frame->height, frame->width, CV_8UC1);
-                    for (int y = 0; y < frame->height; ++y) {
-                        for (int x = 0; x < frame->width; ++x) {
-                            grayFrame.at<uchar>(y, x) = frame->data[0][y * frame->linesize[0] + x];
-                        }
-                    }
-                    // Get terminal size and resize frame
-                    get_terminal_size(termWidth, termHeight);
-                    termHeight -= 2;
-                    if (termWidth != prevTermWidth || termHeight != prevTermHeight) {
-                        prevTermWidth = termWidth;
-                        prevTermHeight = termHeight;
-                        term_size_changed = true;
-
-                    } else
-                        term_size_changed = false;
-                    frameWidth = termWidth;
-                    frameHeight = (grayFrame.rows * frameWidth) / grayFrame.cols / 2;
-                    w_space_count = 0;
-                    h_line_count = (termHeight - frameHeight) / 2;
-                    if (frameHeight > termHeight) {
-                        frameHeight = termHeight;
-                        frameWidth = (grayFrame.cols * frameHeight * 2) / grayFrame.rows;
-                        w_space_count = (termWidth - frameWidth) / 2;
-                        h_line_count = 0;
-                    }
-                    cv::resize(grayFrame, grayFrame, cv::Size(frameWidth, frameHeight));
-
-                    // Convert image to ASCII and display
-                    std::string asciiArt = generate_ascii_func(grayFrame,
-                                                               w_space_count,
-                                                               frame_chars);
-                    current_time = av_rescale_q(packet->pts, video_stream->time_base, AV_TIME_BASE_Q) / AV_TIME_BASE;
-
-                    // Create progress bar
-                    std::string time_played = format_time(current_time);
-                    std::string total_time = format_time(total_duration);
-                    int progress_width = termWidth - (int)time_played.length() - (int)total_time.length() - 2; // 2 for /
-                    double progress = static_cast<double>(current_time) / total_duration;
-                    std::string progress_bar = create_progress_bar(progress, progress_width);
-
-                    // Combine ASCII art with progress bar
-                    std::string combined_output;
-                    add_empty_lines_for(combined_output, h_line_count);
-                    combined_output += asciiArt;
-                    add_empty_lines_for(combined_output,
-                                        termHeight - frameHeight - h_line_count);
-                    combined_output += time_played + "\\" + progress_bar + "/" + total_time + "\n";
-
-                    // clear_screen();
-                    move_cursor_to_top_left(term_size_changed);
-                    printf("%s", combined_output.c_str()); // Show the Frame
-
-                    // Frame rate control
-                    auto end_time = std::chrono::high_resolution_clock::now();
-                    auto processing_time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-                    int remaining_delay = frame_delay - static_cast<int>(processing_time.count()) - 4;
-                    if (remaining_delay > 0) {
-                        std::this_thread::sleep_for(std::chrono::milliseconds(remaining_delay));
-                    }
-                }
-            }
-        } else if (packet->stream_index == audio_stream_index && audio_codec_ctx && swr_ctx) {
-            if (avcodec_send_packet(audio_codec_ctx, packet) >= 0) {
-                while (avcodec_receive_frame(audio_codec_ctx, frame) >= 0) {
-                    int out_samples = (int)av_rescale_rnd(swr_get_delay(swr_ctx, audio_codec_ctx->sample_rate) + frame->nb_samples,
-                                                          spec.freq, audio_codec_ctx->sample_rate, AV_ROUND_UP);
-                    uint8_t *out_buffer;
-                    av_samples_alloc(&out_buffer, NULL, spec.channels, out_samples, AV_SAMPLE_FMT_S16, 0);
-                    int samples_out = swr_convert(swr_ctx, &out_buffer, out_samples,
-                                                  (const uint8_t **)frame->data, frame->nb_samples);
-                    if (samples_out > 0) {
-                        int buffer_size = av_samples_get_buffer_size(NULL, spec.channels, samples_out, AV_SAMPLE_FMT_S16, 1);
-                        SDL_LockMutex(audio_queue.mutex);
-                        if (audio_queue.size + buffer_size < AUDIO_QUEUE_SIZE) {
-                            memcpy(audio_queue.data + audio_queue.size, out_buffer, buffer_size);
-                            audio_queue.size += buffer_size;
-                            // std::cout << "Added " << buffer_size << " bytes to audio queue. Total size: " << audio_queue.size;
-                        } else {
-                            // std::cout << "Audio queue full. Discarding " << buffer_size << " bytes.";
-                        }
-                        SDL_UnlockMutex(audio_queue.mutex);
-                    } else {
-                        // std::cout << "No samples output from swr_convert";
-                    }
-                    av_freep(&out_buffer);
-                }
+        if (quit || is_escape_key_pressed()) {
+            quit = true;
+            break;
+        }
+
+        RenderedFrame rendered;
+        if (!ctx.output_queues[output_index % worker_count]->try_pop(rendered)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        output_index++;
+        // Only the end of what is playing now ends the playback, not one from before a seek
+        if (rendered.eos) {
+            if (rendered.serial == ctx.serial && !ctx.seek_request)
+                break;
+            continue;
+        }
+        if (rendered.skip || rendered.serial != ctx.serial)
+            continue;
+        if (rendered.serial != displayed_serial) {
+            // 开始播放或跳转后，没有音频可跟随之前时钟从这一帧开始走
+            displayed_serial = rendered.serial;
+            ctx.clock.set_external(rendered.pts);
+        }
+
+        // Schedule the frame against the master clock, drop it if it is already too late
+        double delay = rendered.pts - ctx.clock.now();
+        if (should_drop_frame(ctx, rendered.pts)) {
+            ctx.frames_dropped_late++;
+            ctx.quality.frame_dropped();
+            continue;
+        }
+        if (delay > 0 && delay < MAX_FRAME_WAIT)
+            std::this_thread::sleep_for(std::chrono::duration<double>(delay));
+        if (ctx.clock.audio_driven())
+            ctx.clock.set_external(ctx.clock.now()); // 音频结束后从当前位置继续走
+
+        if (rendered.term_width != prevTermWidth || rendered.term_height != prevTermHeight) {
+            prevTermWidth = rendered.term_width;
+            prevTermHeight = rendered.term_height;
+            term_size_changed = true;
+        } else
+            term_size_changed = false;
+        displayed_pts = std::max(rendered.pts - ctx.start_time, 0.0);
+        current_time = static_cast<int64_t>(displayed_pts);
+
+        // Put the progress bar into the last row of the grid
+        GlyphGrid &grid = rendered.grid;
+        std::string status_prefix = ctx.quality.describe();
+        if (steady_clock_ns() < volume_shown_until_ns)
+            status_prefix += "[vol " + std::to_string(volume * 100 / AUDIO_GAIN_UNITY) + "%] ";
+        if (show_queue_depths)
+            status_prefix += format_queue_depths(ctx);
+        draw_status_line(grid, status_prefix, current_time, total_duration);
+        if (show_hud) {
+            int64_t now_ns = steady_clock_ns();
+            if (now_ns >= hud_refresh_ns) {
+                hud_text = format_hud(ctx, ctx.stats.take_window(now_ns), fps, writer.frames_superseded());
+                hud_refresh_ns = now_ns + HUD_REFRESH_NS;
             }
+            draw_hud_line(grid, hud_text);
         }
 
-        av_packet_unref(packet);
+        // Show the Frame: the writer sends only the cells that differ from what it wrote last,
+        // unless the terminal was resized
+        ctx.stats.frame_shown(ctx.clock.now() - rendered.pts);
+        writer.submit(grid, term_size_changed);
+        // grid is now the writer's spare buffer, the worker of this frame converts into it next
+        ctx.spare_grids[(output_index - 1) % worker_count]->try_push(grid);
+        ctx.last_present_ns = steady_clock_ns();
+        // A frame replaced before it reached the terminal is as good as dropped
+        uint64_t superseded = writer.frames_superseded();
+        for (; superseded_seen < superseded; ++superseded_seen)
+            ctx.quality.frame_dropped();
+        ctx.quality.update(ctx.last_present_ns);
+    }
+    writer.stop();
+    terminal_input.stop();
 
-        if (is_escape_key_pressed()) {
-            break;
+    // Stop the pipeline and release everything still queued
+    ctx.abort = true;
+    if (ctx.pipe_input)
+        ctx.pipe_input->interrupt(); // the demuxer may be waiting for a writer that went quiet
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    PacketItem packet_item;
+    while (ctx.video_packets->try_pop(packet_item)) {
+        av_packet_free(&packet_item.packet);
+    }
+    for (auto &queue : ctx.frame_queues) {
+        FrameItem frame_item;
+        while (queue->try_pop(frame_item)) {
+            av_frame_free(&frame_item.frame);
         }
     }
 
     // Clean up
-    av_frame_free(&frame);
-    av_packet_free(&packet);
-    if (audio_device_id) {
-        SDL_CloseAudioDevice(audio_device_id);
-    }
-    SDL_Quit();
+    attach_audio_clock(audio, nullptr);
+    for (AVFrame *frame : ctx.prefetched_frames)
+        av_frame_free(&frame);
+    for (AVPacket *packet : ctx.prefetched_packets)
+        av_packet_free(&packet);
     if (swr_ctx) {
         swr_free(&swr_ctx);
     }
-    avcodec_free_context(&video_codec_ctx);
-    if (audio_codec_ctx) {
-        avcodec_free_context(&audio_codec_ctx);
+    return quit;
+}
+
+void play_video(const std::map<std::string, std::string> &params) {
+    std::string video_path;
+
+    if (params_include(params, "-v")) {
+        video_path = params.at("-v");
+    } else {
+        print_error("No video but wanna play? Really? \nAdd a -v param, or type \"help\" to get usage");
+        return;
+    }
+    // Clips exported with the export command are streamed as they are, pipes never hold one
+    if (!is_pipe_input_path(video_path) && is_ascii_cache_file(video_path)) {
+        play_ascii_cache(params);
+        return;
+    }
+    // Directories, patterns and m3u files are played one item after the other
+    if (is_playlist_source(video_path)) {
+        play_playlist(params);
+        return;
+    }
+
+    // Initialize FFmpeg
+    avformat_network_init();
+
+    int decodeTermWidth = 0, decodeTermHeight = 0;
+    if (!params_include(params, "-fd"))
+        get_terminal_size(decodeTermWidth, decodeTermHeight);
+    MediaInput input;
+    std::string error;
+    if (!open_media_input(video_path, decodeTermWidth, decodeTermHeight, input, error, select_input_options(params))) {
+        print_error(error, video_path);
+        return;
     }
-    avformat_close_input(&format_ctx);
 
-    // Clean up audio queue
-    SDL_DestroyMutex(audio_queue.mutex);
-    delete[] audio_queue.data;
+    AudioOutput audio;
+    bool quit = play_media_input(input, params, audio);
+    close_audio_output(audio);
+    close_media_input(input);
 
     if (!quit) {
         std::cout << "Playback completed! Press any key to continue...";
@@ -10,10 +10,16 @@
 
 #include <SDL2/SDL.h>
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -28,6 +34,23 @@ extern "C" {
 #include <opencv2/opencv.hpp>
 #include <thread>
 
+#include "ascii-kernel.hpp"
+#include "audio-gain.hpp"
+#include "audio-ring-buffer.hpp"
+#include "avio-input.hpp"
+#include "color-mode.hpp"
+#include "glyph-atlas.hpp"
+#include "keyframe-index.hpp"
+#include "luma-scaler.hpp"
+#include "playback-clock.hpp"
+#include "playback-stats.hpp"
+#include "quality-controller.hpp"
+#include "spsc-queue.hpp"
+#include "terminal-input.hpp"
+#include "terminal-renderer.hpp"
+#include "terminal-writer.hpp"
+#include "thread-pool.hpp"
+
 #ifdef _WIN32
 #include <windows.h>
 #else
@@ -36,6 +59,85 @@ extern "C" {
 #endif
 
 #define KEY_DOWN(VK_NONAME) ((GetAsyncKeyState(VK_NONAME) & 0x8000) ? 1 : 0)
+
+typedef std::function<void(const cv::Mat &, GlyphGrid &, int, int, const char *)> AsciiFunc;
+
+// Where a source frame goes on a terminal of term_width x term_height cells
+struct FrameLayout {
+    int term_width, term_height;
+    int frame_width, frame_height;
+    int left, top;
+};
+
+bool is_escape_key_pressed();
+FrameLayout compute_frame_layout(int source_width, int source_height, int term_width, int term_height);
+AsciiFunc select_ascii_func(const std::map<std::string, std::string> &params);
+const char *select_frame_chars(const std::map<std::string, std::string> &params);
+ColorMode select_color_mode(const std::map<std::string, std::string> &params);
+// Luma pixels the glyph renderer of -ct looks at per cell, and whether it draws Unicode glyphs
+struct CellSampling {
+    int sub_x = 1, sub_y = 1;
+    bool wide_glyphs = false;
+};
+CellSampling select_cell_sampling(const std::map<std::string, std::string> &params);
+// -j: threads converting the row bands of one frame, the converting thread included (1 = no bands)
+size_t select_band_threads(const std::map<std::string, std::string> &params);
+// Sets up decoder threads, and lowres/skipped filters when a term_width x term_height terminal
+// shows far fewer pixels than the source has. A size of 0 keeps full quality. Call before avcodec_open2.
+void configure_video_decoder(AVCodecContext *codec_ctx, const AVCodec *codec, int term_width, int term_height);
+void draw_status_line(GlyphGrid &grid, const std::string &prefix, int64_t current_time, int64_t total_duration);
+
+// A video that is opened and probed, with its decoders open, ready to be played
+struct MediaInput {
+    std::string path;
+    AVFormatContext *format_ctx = nullptr;
+    AVCodecContext *video_codec_ctx = nullptr;
+    AVCodecContext *audio_codec_ctx = nullptr; // nullptr when there is no playable audio
+    int video_stream_index = -1;
+    int audio_stream_index = -1;
+    // Custom I/O for format_ctx: stdin and pipes, or a mapped local file with -mm
+    std::unique_ptr<PipeInput> pipe;
+    std::unique_ptr<MappedFileInput> mapped;
+    // Filled by prefetch_media_input: the first decoded frames (at most 32 MB of them), and the packets
+    // read after them that the playback still has to handle, in file order
+    std::vector<AVFrame *> prefetched_frames;
+    std::vector<AVPacket *> prefetched_packets;
+};
+
+struct AudioCallbackData {
+    AudioRingBuffer *audio_ring;
+    PlaybackClock *clock;                         // nullptr between two playlist items
+    std::atomic<int> volume{AUDIO_GAIN_UNITY}; // up/down keys, kept across playlist items
+};
+
+// The SDL audio device, opened by the first video with sound and kept open across playlist items
+struct AudioOutput {
+    SDL_AudioDeviceID device_id = 0;
+    SDL_AudioSpec spec = {};
+    std::unique_ptr<AudioRingBuffer> ring;
+    AudioCallbackData callback_data = {nullptr, nullptr};
+    bool sdl_initialized = false;
+};
+
+// How open_media_input reads the file
+struct MediaInputOptions {
+    size_t pipe_buffer_size = DEFAULT_PIPE_BUFFER_SIZE; // -ib, read-ahead for stdin and pipes
+    bool memory_mapped = false;                         // -mm, local files through MappedFileInput
+    CellSampling sampling;                              // -ct, so lowres leaves the renderer enough pixels
+};
+MediaInputOptions select_input_options(const std::map<std::string, std::string> &params);
+
+// Opens path for a term_width x term_height terminal (0 keeps full decoding quality).
+// Does not print anything, error is set when it fails, so it can run on a background thread.
+// "-" and named pipes are read ahead by a PipeInput, -mm maps local files when the system can.
+bool open_media_input(const std::string &path, int term_width, int term_height, MediaInput &input, std::string &error,
+                      const MediaInputOptions &options = MediaInputOptions());
+// Reads up to the second keyframe and decodes the start of it, so the first frames are ready before playback starts
+void prefetch_media_input(MediaInput &input);
+void close_media_input(MediaInput &input);
+void close_audio_output(AudioOutput &audio);
+// Plays an opened input to its end, returns true when the user stopped it
+bool play_media_input(MediaInput &input, const std::map<std::string, std::string> &params, AudioOutput &audio);
 void play_video(const std::map<std::string, std::string> &params);
 
 #endif /* video_player_hpp */